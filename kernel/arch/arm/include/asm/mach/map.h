@@ -29,9 +29,11 @@ struct map_desc {
 #define MT_MEMORY_NONCACHED	11
 #define MT_MEMORY_DTCM		12
 #define MT_MEMORY_ITCM		13
+#define MT_MEMORY_DMA_READY	14
 
 #ifdef CONFIG_MMU
 extern void iotable_init(struct map_desc *, int);
+extern int map_lowmem_pages(phys_addr_t start, size_t size);
 
 struct mem_type;
 extern const struct mem_type *get_mem_type(unsigned int type);
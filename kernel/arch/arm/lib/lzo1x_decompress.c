@@ -0,0 +1,278 @@
+/*
+ *  linux/arch/arm/lib/lzo1x_decompress.c
+ *
+ *  LZO1X decompressor for ARMv7, derived from lib/lzo/lzo1x_decompress.c
+ *
+ *  Copyright (C) 1996-2005 Markus F.X.J. Oberhumer <markus@oberhumer.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * ARMv6 and later CPUs perform unaligned LDR/STR in hardware (see
+ * alignment_init()), so literal runs and matches are copied with plain
+ * word accesses instead of the byte-wise get_unaligned(), 16 or 8
+ * bytes per iteration when the match source is far enough behind.
+ * The tail of each copy is done with words and bytes, so like the
+ * portable version nothing is stored past the returned length.
+ *
+ * All checks are the portable version's, made in the same order, so
+ * both give the same result and out_len for any input.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/lzo.h>
+#include <asm/unaligned.h>
+
+#define M2_MAX_OFFSET	0x0800
+
+#define HAVE_IP(x, ip_end, ip) ((size_t)(ip_end - ip) < (x))
+#define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
+#define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
+
+/* Single LDR/STR: unlike LDM or LDRD, these may be unaligned */
+static inline u32 load32(const unsigned char *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void store32(unsigned char *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+
+static inline void copy8(unsigned char *dst, const unsigned char *src)
+{
+	u32 a = load32(src), b = load32(src + 4);
+
+	store32(dst, a);
+	store32(dst + 4, b);
+}
+
+static inline void copy16(unsigned char *dst, const unsigned char *src)
+{
+	u32 a = load32(src), b = load32(src + 4);
+	u32 c = load32(src + 8), d = load32(src + 12);
+
+	store32(dst, a);
+	store32(dst + 4, b);
+	store32(dst + 8, c);
+	store32(dst + 12, d);
+}
+
+/*
+ * Copy 'len' bytes from 'src', which is 'dist' bytes behind 'dst' and
+ * at least 4, without touching anything past either end.
+ */
+static inline void copy_words(unsigned char *dst, const unsigned char *src,
+			      size_t len, size_t dist)
+{
+	if (dist >= 16) {
+		for (; len >= 16; len -= 16, dst += 16, src += 16)
+			copy16(dst, src);
+	}
+	if (dist >= 8) {
+		for (; len >= 8; len -= 8, dst += 8, src += 8)
+			copy8(dst, src);
+	}
+	for (; len >= 4; len -= 4, dst += 4, src += 4)
+		store32(dst, load32(src));
+	while (len--)
+		*dst++ = *src++;
+}
+
+int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+			unsigned char *out, size_t *out_len)
+{
+	const unsigned char * const ip_end = in + in_len;
+	unsigned char * const op_end = out + *out_len;
+	const unsigned char *ip = in, *m_pos;
+	unsigned char *op = out;
+	size_t t;
+
+	*out_len = 0;
+
+	if (*ip > 17) {
+		t = *ip++ - 17;
+		if (t < 4)
+			goto match_next;
+		if (HAVE_OP(t, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 1, ip_end, ip))
+			goto input_overrun;
+		do {
+			*op++ = *ip++;
+		} while (--t > 0);
+		goto first_literal_run;
+	}
+
+	while ((ip < ip_end)) {
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		if (t == 0) {
+			if (HAVE_IP(1, ip_end, ip))
+				goto input_overrun;
+			while (*ip == 0) {
+				t += 255;
+				ip++;
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
+			}
+			t += 15 + *ip++;
+		}
+		if (HAVE_OP(t + 3, op_end, op))
+			goto output_overrun;
+		if (HAVE_IP(t + 4, ip_end, ip))
+			goto input_overrun;
+
+		/* Literal run of t + 3 bytes, from the other buffer */
+		t += 3;
+		copy_words(op, ip, t, 16);
+		op += t;
+		ip += t;
+
+first_literal_run:
+		t = *ip++;
+		if (t >= 16)
+			goto match;
+		m_pos = op - (1 + M2_MAX_OFFSET);
+		m_pos -= t >> 2;
+		m_pos -= *ip++ << 2;
+
+		if (HAVE_LB(m_pos, out, op))
+			goto lookbehind_overrun;
+
+		if (HAVE_OP(3, op_end, op))
+			goto output_overrun;
+		*op++ = *m_pos++;
+		*op++ = *m_pos++;
+		*op++ = *m_pos;
+
+		goto match_done;
+
+		do {
+match:
+			if (t >= 64) {
+				m_pos = op - 1;
+				m_pos -= (t >> 2) & 7;
+				m_pos -= *ip++ << 3;
+				t = (t >> 5) - 1;
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(t + 3 - 1, op_end, op))
+					goto output_overrun;
+				goto copy_match;
+			} else if (t >= 32) {
+				t &= 31;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 31 + *ip++;
+				}
+				m_pos = op - 1;
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+			} else if (t >= 16) {
+				m_pos = op;
+				m_pos -= (t & 8) << 11;
+
+				t &= 7;
+				if (t == 0) {
+					if (HAVE_IP(1, ip_end, ip))
+						goto input_overrun;
+					while (*ip == 0) {
+						t += 255;
+						ip++;
+						if (HAVE_IP(1, ip_end, ip))
+							goto input_overrun;
+					}
+					t += 7 + *ip++;
+				}
+				m_pos -= get_unaligned_le16(ip) >> 2;
+				ip += 2;
+				if (m_pos == op)
+					goto eof_found;
+				m_pos -= 0x4000;
+			} else {
+				m_pos = op - 1;
+				m_pos -= t >> 2;
+				m_pos -= *ip++ << 2;
+
+				if (HAVE_LB(m_pos, out, op))
+					goto lookbehind_overrun;
+				if (HAVE_OP(2, op_end, op))
+					goto output_overrun;
+
+				*op++ = *m_pos++;
+				*op++ = *m_pos;
+				goto match_done;
+			}
+
+			if (HAVE_LB(m_pos, out, op))
+				goto lookbehind_overrun;
+			if (HAVE_OP(t + 3 - 1, op_end, op))
+				goto output_overrun;
+
+copy_match:
+			/* Match of t + 2 bytes, starting op - m_pos behind */
+			t += 2;
+			if ((size_t)(op - m_pos) >= 4) {
+				copy_words(op, m_pos, t, op - m_pos);
+				op += t;
+			} else {
+				do {
+					*op++ = *m_pos++;
+				} while (--t > 0);
+			}
+match_done:
+			t = ip[-2] & 3;
+			if (t == 0)
+				break;
+match_next:
+			if (HAVE_OP(t, op_end, op))
+				goto output_overrun;
+			if (HAVE_IP(t + 1, ip_end, ip))
+				goto input_overrun;
+
+			*op++ = *ip++;
+			if (t > 1) {
+				*op++ = *ip++;
+				if (t > 2)
+					*op++ = *ip++;
+			}
+
+			t = *ip++;
+		} while (ip < ip_end);
+	}
+
+	*out_len = op - out;
+	return LZO_E_EOF_NOT_FOUND;
+
+eof_found:
+	*out_len = op - out;
+	return (ip == ip_end ? LZO_E_OK :
+		(ip < ip_end ? LZO_E_INPUT_NOT_CONSUMED : LZO_E_INPUT_OVERRUN));
+input_overrun:
+	*out_len = op - out;
+	return LZO_E_INPUT_OVERRUN;
+
+output_overrun:
+	*out_len = op - out;
+	return LZO_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*out_len = op - out;
+	return LZO_E_LOOKBEHIND_OVERRUN;
+}
+EXPORT_SYMBOL_GPL(lzo1x_decompress_safe);
@@ -154,6 +154,8 @@ void __init u5500_map_io(void)
 	iotable_init(u5500_io_desc, ARRAY_SIZE(u5500_io_desc));
 
 	_PRCMU_BASE = __io_address(U5500_PRCMU_BASE);
+
+	ux500_hwmem_reserve();
 }
 
 void __init u5500_init_devices(void)
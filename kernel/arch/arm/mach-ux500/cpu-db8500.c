@@ -225,6 +225,8 @@ void __init u8500_map_io(void)
 
 	/* Read out the ASIC ID as early as we can */
 	get_db8500_asic_id();
+
+	ux500_hwmem_reserve();
 }
 
 static void __init u8500_earlydrop_fixup(void)
@@ -13,6 +13,9 @@
 #include <linux/mm.h>
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/bootmem.h>
+#include <asm/mach/map.h>
+#include <mach/setup.h>
 
 /* CONA API */
 void *cona_create(const char *name, phys_addr_t region_paddr,
@@ -22,12 +25,16 @@ void cona_free(void *instance, void *alloc);
 phys_addr_t cona_get_alloc_paddr(void *alloc);
 void *cona_get_alloc_kaddr(void *instance, void *alloc);
 size_t cona_get_alloc_size(void *alloc);
+void cona_set_alloc_pgprot(void *instance, void *alloc, pgprot_t pgprot);
 
 struct hwmem_mem_type_struct *hwmem_mem_types;
 unsigned int hwmem_num_mem_types;
 
 static phys_addr_t hwmem_paddr;
 static size_t hwmem_size;
+#ifdef CONFIG_CMA
+static bool hwmem_reserved;
+#endif /* #ifdef CONFIG_CMA */
 
 static int __init parse_hwmem_param(char *p)
 {
@@ -47,6 +54,44 @@ no_at:
 }
 early_param("hwmem", parse_hwmem_param);
 
+#ifdef CONFIG_CMA
+/*
+ * A region in system RAM is lent to the page allocator for movable pages.
+ * Called from map_io(), it keeps the boot allocator away from the region
+ * until cona hands it over, and maps it with pages so that the memory type
+ * of allocs can be applied to the linear mapping as well.
+ */
+void __init ux500_hwmem_reserve(void)
+{
+	const phys_addr_t align = PAGE_SIZE << pageblock_order;
+	phys_addr_t lowmem_end = __pa(high_memory - 1) + 1;
+
+	if (hwmem_size == 0 || !pfn_valid(PFN_DOWN(hwmem_paddr)))
+		return;
+
+	if ((hwmem_paddr | hwmem_size) & (align - 1) ||
+		hwmem_paddr + hwmem_size > lowmem_end) {
+		printk(KERN_WARNING "HWMEM: Region in system RAM must be in"
+			" lowmem and aligned to %u bytes\n", align);
+		return;
+	}
+
+	if (reserve_bootmem(hwmem_paddr, hwmem_size, BOOTMEM_EXCLUSIVE) < 0) {
+		printk(KERN_WARNING "HWMEM: Region %#x - %#x is in use\n",
+				hwmem_paddr, hwmem_paddr + hwmem_size);
+		return;
+	}
+
+	if (map_lowmem_pages(hwmem_paddr, hwmem_size) < 0) {
+		printk(KERN_WARNING "HWMEM: Failed to map region with pages\n");
+		free_bootmem(hwmem_paddr, hwmem_size);
+		return;
+	}
+
+	hwmem_reserved = true;
+}
+#endif /* #ifdef CONFIG_CMA */
+
 static int __init setup_hwmem(void)
 {
 	static const unsigned int NUM_MEM_TYPES = 2;
@@ -61,6 +106,14 @@ static int __init setup_hwmem(void)
 		return -ENOMSG;
 	}
 
+#ifdef CONFIG_CMA
+	if (pfn_valid(PFN_DOWN(hwmem_paddr)) && !hwmem_reserved) {
+		printk(KERN_WARNING "HWMEM: Region in system RAM was not"
+							" reserved at boot\n");
+		return -ENOMSG;
+	}
+#endif /* #ifdef CONFIG_CMA */
+
 	hwmem_mem_types = kzalloc(sizeof(struct hwmem_mem_type_struct) *
 						NUM_MEM_TYPES, GFP_KERNEL);
 	if (hwmem_mem_types == NULL)
@@ -74,6 +127,8 @@ static int __init setup_hwmem(void)
 	hwmem_mem_types[0].allocator_api.get_alloc_kaddr =
 							cona_get_alloc_kaddr;
 	hwmem_mem_types[0].allocator_api.get_alloc_size = cona_get_alloc_size;
+	hwmem_mem_types[0].allocator_api.set_alloc_pgprot =
+							cona_set_alloc_pgprot;
 	hwmem_mem_types[0].allocator_instance = cona_create("hwmem",
 						hwmem_paddr, hwmem_size);
 	if (IS_ERR(hwmem_mem_types[0].allocator_instance)) {
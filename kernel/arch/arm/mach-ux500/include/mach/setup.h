@@ -20,6 +20,12 @@ struct amba_device;
 extern void __init u5500_map_io(void);
 extern void __init u8500_map_io(void);
 
+#if defined(CONFIG_HWMEM) && defined(CONFIG_CMA)
+extern void __init ux500_hwmem_reserve(void);
+#else
+static inline void ux500_hwmem_reserve(void) { }
+#endif
+
 extern void __init ux500_init_devices(void);
 extern void __init u5500_init_devices(void);
 extern void __init u8500_init_devices(void);
@@ -271,6 +271,12 @@ static struct mem_type mem_types[] = {
 		.prot_l1   = PMD_TYPE_TABLE,
 		.domain    = DOMAIN_IO,
 	},
+	[MT_MEMORY_DMA_READY] = {
+		.prot_pte  = L_PTE_PRESENT | L_PTE_YOUNG | L_PTE_DIRTY |
+				L_PTE_WRITE,
+		.prot_l1   = PMD_TYPE_TABLE,
+		.domain    = DOMAIN_KERNEL,
+	},
 	/* NOTE : this is only a temporary hack!!!
 	 *        The U8500 ED/V1.0 cuts require such a
 	 *        memory type for deep sleep resume.
@@ -487,8 +493,11 @@ static void __init build_mem_type_table(void)
 	pgprot_kernel = __pgprot(L_PTE_PRESENT | L_PTE_YOUNG |
 				 L_PTE_DIRTY | L_PTE_WRITE | kern_pgprot);
 
+	mem_types[MT_MEMORY_DMA_READY].prot_pte |= kern_pgprot;
+
 	mem_types[MT_LOW_VECTORS].prot_l1 |= ecc_mask;
 	mem_types[MT_HIGH_VECTORS].prot_l1 |= ecc_mask;
+	mem_types[MT_MEMORY_DMA_READY].prot_l1 |= ecc_mask;
 	mem_types[MT_MEMORY].prot_sect |= ecc_mask | cp->pmd;
 	mem_types[MT_ROM].prot_sect |= cp->pmd;
 
@@ -541,11 +550,11 @@ static void __init alloc_init_section(pgd_t *pgd, unsigned long addr,
 
 	/*
 	 * Try a section mapping - end, addr and phys must all be aligned
-	 * to a section boundary.  Note that PMDs refer to the individual
-	 * L1 entries, whereas PGDs refer to a group of L1 entries making
-	 * up one logical pointer to an L2 table.
+	 * to a section boundary, and the type must allow it.  Note that
+	 * PMDs refer to the individual L1 entries, whereas PGDs refer to a
+	 * group of L1 entries making up one logical pointer to an L2 table.
 	 */
-	if (((addr | end | phys) & ~SECTION_MASK) == 0) {
+	if (type->prot_sect && ((addr | end | phys) & ~SECTION_MASK) == 0) {
 		pmd_t *p = pmd;
 
 		if (addr & SECTION_SIZE)
@@ -1035,6 +1044,40 @@ static void __init devicemaps_init(struct machine_desc *mdesc)
 	flush_cache_all();
 }
 
+/*
+ * Map part of lowmem with pages rather than sections, so that the memory
+ * type of single pages can be changed later on, e.g. to match another
+ * mapping of memory that is handed to devices.  Called from the machine's
+ * map_io(), for memory that nothing uses yet.  The range must be aligned
+ * to PMD_SIZE.
+ */
+int __init map_lowmem_pages(phys_addr_t start, size_t size)
+{
+	phys_addr_t end = start + size;
+	struct map_desc map;
+	unsigned long addr;
+
+	if (((start | end) & ~PMD_MASK) || start < PHYS_OFFSET ||
+	    end > __pa(high_memory - 1) + 1)
+		return -EINVAL;
+
+	/*
+	 * Clear the section mappings, the tlb is flushed once map_io()
+	 * returns.
+	 */
+	for (addr = __phys_to_virt(start); addr < __phys_to_virt(end);
+	     addr += PMD_SIZE)
+		pmd_clear(pmd_off_k(addr));
+
+	map.pfn = __phys_to_pfn(start);
+	map.virtual = __phys_to_virt(start);
+	map.length = size;
+	map.type = MT_MEMORY_DMA_READY;
+	iotable_init(&map, 1);
+
+	return 0;
+}
+
 static void __init kmap_init(void)
 {
 #ifdef CONFIG_HIGHMEM
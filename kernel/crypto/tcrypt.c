@@ -21,6 +21,7 @@
 #include <linux/gfp.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/moduleparam.h>
 #include <linux/jiffies.h>
@@ -57,7 +58,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "lz4", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -711,6 +712,180 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+static int test_comp_op(struct crypto_comp *tfm, int enc, const u8 *src,
+			unsigned int slen, u8 *dst, unsigned int *dlen)
+{
+	*dlen = 2 * PAGE_SIZE;
+	if (enc)
+		return crypto_comp_compress(tfm, src, slen, dst, dlen);
+	else
+		return crypto_comp_decompress(tfm, src, slen, dst, dlen);
+}
+
+static int test_comp_jiffies(struct crypto_comp *tfm, int enc, const u8 *src,
+			     unsigned int slen, u8 *dst, int blen, int sec)
+{
+	unsigned long start, end;
+	unsigned int dlen;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = test_comp_op(tfm, enc, src, slen, dst, &dlen);
+		if (ret)
+			return ret;
+	}
+
+	printk("%d operations in %d seconds (%ld bytes)\n",
+	       bcount, sec, (long)bcount * blen);
+	return 0;
+}
+
+static int test_comp_cycles(struct crypto_comp *tfm, int enc, const u8 *src,
+			    unsigned int slen, u8 *dst, int blen)
+{
+	unsigned long cycles = 0;
+	unsigned int dlen;
+	int ret = 0;
+	int i;
+
+	local_bh_disable();
+	local_irq_disable();
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = test_comp_op(tfm, enc, src, slen, dst, &dlen);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = test_comp_op(tfm, enc, src, slen, dst, &dlen);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	local_irq_enable();
+	local_bh_enable();
+
+	if (ret == 0)
+		printk("1 operation in %lu cycles (%d bytes)\n",
+		       (cycles + 4) / 8, blen);
+
+	return ret;
+}
+
+/*
+ * Fill 'buf' with lines of words and numbers, which compress to around
+ * a third of their size, like typical anonymous memory or text files.
+ */
+static void test_comp_fill(char *buf, unsigned int len)
+{
+	static const char * const words[] = {
+		"the", "page", "swap", "memory", "kernel", "struct", "return",
+		"compress", "data", "block", "0x00000000", "NULL", "int",
+	};
+	u32 seed = 1;
+	unsigned int i = 0;
+	const char *w;
+
+	while (i < len) {
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 8 == 0)
+			w = (seed >> 24) & 1 ? "\n" : "\t";
+		else if ((seed >> 16) % 8 == 1)
+			w = "42 ";
+		else
+			w = words[(seed >> 19) % ARRAY_SIZE(words)];
+		while (*w && i < len)
+			buf[i++] = *w++;
+		if (i < len)
+			buf[i++] = (seed >> 27) & 1 ? ' ' : (seed >> 28) + '0';
+	}
+}
+
+static u32 comp_block_sizes[] = { 512, 1024, 2048, 4096, 0 };
+
+static void test_comp_speed(const char *algo, unsigned int sec)
+{
+	struct crypto_comp *tfm;
+	unsigned int clen;
+	u8 *src, *comp, *decomp;
+	u32 *b_size;
+	int ret;
+
+	printk(KERN_INFO "\ntesting speed of %s compression\n", algo);
+
+	tfm = crypto_alloc_comp(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		printk(KERN_ERR "failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	src = tvmem[0];
+	/* room for the worst case expansion of incompressible blocks */
+	comp = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	decomp = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	if (!comp || !decomp)
+		goto out;
+
+	test_comp_fill(src, PAGE_SIZE);
+
+	for (b_size = comp_block_sizes; *b_size; b_size++) {
+		if (*b_size > PAGE_SIZE)
+			break;
+
+		ret = test_comp_op(tfm, ENCRYPT, src, *b_size, comp, &clen);
+		if (ret) {
+			printk(KERN_ERR "compression failed ret=%d\n", ret);
+			break;
+		}
+
+		printk(KERN_INFO "%5u byte blocks, compressed to %u bytes\n",
+		       *b_size, clen);
+
+		printk(KERN_INFO "compression: ");
+		if (sec)
+			ret = test_comp_jiffies(tfm, ENCRYPT, src, *b_size,
+						decomp, *b_size, sec);
+		else
+			ret = test_comp_cycles(tfm, ENCRYPT, src, *b_size,
+					       decomp, *b_size);
+		if (ret) {
+			printk(KERN_ERR "compression failed ret=%d\n", ret);
+			break;
+		}
+
+		printk(KERN_INFO "decompression: ");
+		if (sec)
+			ret = test_comp_jiffies(tfm, DECRYPT, comp, clen,
+						decomp, *b_size, sec);
+		else
+			ret = test_comp_cycles(tfm, DECRYPT, comp, clen,
+					       decomp, *b_size);
+		if (ret) {
+			printk(KERN_ERR "decompression failed ret=%d\n", ret);
+			break;
+		}
+	}
+
+out:
+	kfree(decomp);
+	kfree(comp);
+	crypto_free_comp(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -936,6 +1111,10 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4309(ccm(aes))");
 		break;
 
+	case 46:
+		ret += tcrypt_test("lz4");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1215,6 +1394,28 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 500:
+		/* fall through */
+
+	case 501:
+		test_comp_speed("lzo", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 502:
+		test_comp_speed("lz4", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 503:
+		test_comp_speed("snappy", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 504:
+		test_comp_speed("deflate", sec);
+		if (mode > 500 && mode < 600) break;
+
+	case 599:
+		break;
+
 	case 1000:
 		test_available();
 		break;
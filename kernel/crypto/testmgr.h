@@ -9381,6 +9381,86 @@ static struct comp_testvec lzo_decomp_tv_template[] = {
 	},
 };
 
+/*
+ * LZ4 test vectors (null-terminated strings).
+ */
+#define LZ4_COMP_TEST_VECTORS 2
+#define LZ4_DECOMP_TEST_VECTORS 2
+
+static struct comp_testvec lz4_comp_tv_template[] = {
+	{
+		.inlen	= 70,
+		.outlen	= 45,
+		.input	= "Join us now and share the software "
+			"Join us now and share the software ",
+		.output	= "\xf0\x10\x4a\x6f\x69\x6e\x20\x75"
+			  "\x73\x20\x6e\x6f\x77\x20\x61\x6e"
+			  "\x64\x20\x73\x68\x61\x72\x65\x20"
+			  "\x74\x68\x65\x20\x73\x6f\x66\x74"
+			  "\x77\x0d\x00\x0f\x23\x00\x0b\x50"
+			  "\x77\x61\x72\x65\x20",
+	}, {
+		.inlen	= 158,
+		.outlen	= 125,
+		.input	= "This document describes a compression method based on the LZ4 "
+			"compression algorithm.  This document defines the application of "
+			"the LZ4 algorithm used in zram.",
+		.output	= "\xf9\x2e\x54\x68\x69\x73\x20\x64"
+			  "\x6f\x63\x75\x6d\x65\x6e\x74\x20"
+			  "\x64\x65\x73\x63\x72\x69\x62\x65"
+			  "\x73\x20\x61\x20\x63\x6f\x6d\x70"
+			  "\x72\x65\x73\x73\x69\x6f\x6e\x20"
+			  "\x6d\x65\x74\x68\x6f\x64\x20\x62"
+			  "\x61\x73\x65\x64\x20\x6f\x6e\x20"
+			  "\x74\x68\x65\x20\x4c\x5a\x34\x24"
+			  "\x00\xcc\x61\x6c\x67\x6f\x72\x69"
+			  "\x74\x68\x6d\x2e\x20\x20\x56\x00"
+			  "\x51\x66\x69\x6e\x65\x73\x36\x00"
+			  "\x80\x61\x70\x70\x6c\x69\x63\x61"
+			  "\x74\x56\x00\x21\x6f\x66\x13\x00"
+			  "\x00\x49\x00\x05\x3d\x00\xe0\x20"
+			  "\x75\x73\x65\x64\x20\x69\x6e\x20"
+			  "\x7a\x72\x61\x6d\x2e",
+	},
+};
+
+static struct comp_testvec lz4_decomp_tv_template[] = {
+	{
+		.inlen	= 125,
+		.outlen	= 158,
+		.input	= "\xf9\x2e\x54\x68\x69\x73\x20\x64"
+			  "\x6f\x63\x75\x6d\x65\x6e\x74\x20"
+			  "\x64\x65\x73\x63\x72\x69\x62\x65"
+			  "\x73\x20\x61\x20\x63\x6f\x6d\x70"
+			  "\x72\x65\x73\x73\x69\x6f\x6e\x20"
+			  "\x6d\x65\x74\x68\x6f\x64\x20\x62"
+			  "\x61\x73\x65\x64\x20\x6f\x6e\x20"
+			  "\x74\x68\x65\x20\x4c\x5a\x34\x24"
+			  "\x00\xcc\x61\x6c\x67\x6f\x72\x69"
+			  "\x74\x68\x6d\x2e\x20\x20\x56\x00"
+			  "\x51\x66\x69\x6e\x65\x73\x36\x00"
+			  "\x80\x61\x70\x70\x6c\x69\x63\x61"
+			  "\x74\x56\x00\x21\x6f\x66\x13\x00"
+			  "\x00\x49\x00\x05\x3d\x00\xe0\x20"
+			  "\x75\x73\x65\x64\x20\x69\x6e\x20"
+			  "\x7a\x72\x61\x6d\x2e",
+		.output	= "This document describes a compression method based on the LZ4 "
+			"compression algorithm.  This document defines the application of "
+			"the LZ4 algorithm used in zram.",
+	}, {
+		.inlen	= 45,
+		.outlen	= 70,
+		.input	= "\xf0\x10\x4a\x6f\x69\x6e\x20\x75"
+			  "\x73\x20\x6e\x6f\x77\x20\x61\x6e"
+			  "\x64\x20\x73\x68\x61\x72\x65\x20"
+			  "\x74\x68\x65\x20\x73\x6f\x66\x74"
+			  "\x77\x0d\x00\x0f\x23\x00\x0b\x50"
+			  "\x77\x61\x72\x65\x20",
+		.output	= "Join us now and share the software "
+			"Join us now and share the software ",
+	},
+};
+
 /*
  * Michael MIC test vectors from IEEE 802.11i
  */
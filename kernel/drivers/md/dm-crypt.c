@@ -39,8 +39,10 @@ struct convert_context {
 	unsigned int offset_out;
 	unsigned int idx_in;
 	unsigned int idx_out;
+	unsigned int idx_in_end;
 	sector_t sector;
 	atomic_t pending;
+	struct ablkcipher_request *req;
 };
 
 /*
@@ -57,6 +59,12 @@ struct dm_crypt_io {
 	int error;
 	sector_t sector;
 	struct dm_crypt_io *base_io;
+
+	/* position of a write clone in the submission order */
+	struct list_head write_entry;
+	unsigned int write_seq;
+	unsigned int write_frag;
+	int write_last;
 };
 
 struct dm_crypt_request {
@@ -105,7 +113,18 @@ struct crypt_config {
 	struct bio_set *bs;
 
 	struct workqueue_struct *io_queue;
+	struct workqueue_struct *write_queue;
 	struct workqueue_struct *crypt_queue;
+	int crypt_cpu;
+
+	/*
+	 * write clones waiting for the clones before them to be submitted
+	 */
+	spinlock_t write_lock;
+	struct list_head write_list;
+	unsigned int write_seq;
+	unsigned int write_next_seq;
+	unsigned int write_next_frag;
 
 	/*
 	 * crypto related data
@@ -133,7 +152,6 @@ struct crypt_config {
 	 * correctly aligned.
 	 */
 	unsigned int dmreq_start;
-	struct ablkcipher_request *req;
 
 	char cipher[CRYPTO_MAX_ALG_NAME];
 	char chainmode[CRYPTO_MAX_ALG_NAME];
@@ -146,11 +164,13 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 #define MIN_BIO_PAGES  8
+#define MIN_CHUNK_SIZE (16 << 10)
 
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static void kcryptd_queue_chunk(struct dm_crypt_io *io);
 
 /*
  * Different IV generation algorithms:
@@ -387,10 +407,33 @@ static void crypt_convert_init(struct crypt_config *cc,
 	ctx->offset_out = 0;
 	ctx->idx_in = bio_in ? bio_in->bi_idx : 0;
 	ctx->idx_out = bio_out ? bio_out->bi_idx : 0;
+	ctx->idx_in_end = bio_in ? bio_in->bi_vcnt : 0;
 	ctx->sector = sector + cc->iv_offset;
+	ctx->req = NULL;
 	init_completion(&ctx->restart);
 }
 
+/*
+ * Move a position in a bio forward by size bytes
+ */
+static void crypt_advance(struct bio *bio, unsigned int *idx,
+			  unsigned int *offset, unsigned int size)
+{
+	struct bio_vec *bv;
+	unsigned int len;
+
+	while (size) {
+		bv = bio_iovec_idx(bio, *idx);
+		len = min(size, bv->bv_len - *offset);
+		size -= len;
+		*offset += len;
+		if (*offset == bv->bv_len) {
+			*offset = 0;
+			(*idx)++;
+		}
+	}
+}
+
 static struct dm_crypt_request *dmreq_of_req(struct crypt_config *cc,
 					     struct ablkcipher_request *req)
 {
@@ -457,16 +500,22 @@ static int crypt_convert_block(struct crypt_config *cc,
 
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
+
+/*
+ * A request is kept by the context until it is handed to an asynchronous
+ * cipher or the conversion returns, so that conversions running in
+ * parallel don't share one.
+ */
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
-	if (!cc->req)
-		cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
-	ablkcipher_request_set_tfm(cc->req, cc->tfm);
-	ablkcipher_request_set_callback(cc->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	if (!ctx->req)
+		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	ablkcipher_request_set_tfm(ctx->req, cc->tfm);
+	ablkcipher_request_set_callback(ctx->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
 					CRYPTO_TFM_REQ_MAY_SLEEP,
 					kcryptd_async_done,
-					dmreq_of_req(cc, cc->req));
+					dmreq_of_req(cc, ctx->req));
 }
 
 /*
@@ -475,18 +524,18 @@ static void crypt_alloc_req(struct crypt_config *cc,
 static int crypt_convert(struct crypt_config *cc,
 			 struct convert_context *ctx)
 {
-	int r;
+	int r = 0;
 
 	atomic_set(&ctx->pending, 1);
 
-	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
+	while(ctx->idx_in < ctx->idx_in_end &&
 	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
 
 		crypt_alloc_req(cc, ctx);
 
 		atomic_inc(&ctx->pending);
 
-		r = crypt_convert_block(cc, ctx, cc->req);
+		r = crypt_convert_block(cc, ctx, ctx->req);
 
 		switch (r) {
 		/* async */
@@ -495,7 +544,7 @@ static int crypt_convert(struct crypt_config *cc,
 			INIT_COMPLETION(ctx->restart);
 			/* fall through*/
 		case -EINPROGRESS:
-			cc->req = NULL;
+			ctx->req = NULL;
 			ctx->sector++;
 			continue;
 
@@ -509,11 +558,21 @@ static int crypt_convert(struct crypt_config *cc,
 		/* error */
 		default:
 			atomic_dec(&ctx->pending);
-			return r;
+			goto out;
 		}
 	}
 
-	return 0;
+out:
+	/*
+	 * Don't keep the request while the io waits for other chunks,
+	 * they may need it to make progress.
+	 */
+	if (ctx->req) {
+		mempool_free(ctx->req, cc->req_pool);
+		ctx->req = NULL;
+	}
+
+	return r;
 }
 
 static void dm_crypt_bio_destructor(struct bio *bio)
@@ -594,17 +653,21 @@ static void crypt_free_buffer_pages(struct crypt_config *cc, struct bio *clone)
 }
 
 static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
-					  struct bio *bio, sector_t sector)
+					  struct bio *bio, sector_t sector,
+					  gfp_t gfp_mask)
 {
 	struct crypt_config *cc = ti->private;
 	struct dm_crypt_io *io;
 
-	io = mempool_alloc(cc->io_pool, GFP_NOIO);
+	io = mempool_alloc(cc->io_pool, gfp_mask);
+	if (!io)
+		return NULL;
 	io->target = ti;
 	io->base_bio = bio;
 	io->sector = sector;
 	io->error = 0;
 	io->base_io = NULL;
+	io->ctx.req = NULL;
 	atomic_set(&io->pending, 0);
 
 	return io;
@@ -642,14 +705,17 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 }
 
 /*
- * kcryptd/kcryptd_io:
+ * kcryptd/kcryptd_write/kcryptd_io:
  *
  * Needed because it would be very unwise to do decryption in an
  * interrupt context.
  *
- * kcryptd performs the actual encryption or decryption.
+ * kcryptd performs the actual encryption or decryption, on all cpus.
+ *
+ * kcryptd_write allocates the buffers of writes and splits them in
+ * chunks for kcryptd, in the order they arrived.
  *
- * kcryptd_io performs the IO submission.
+ * kcryptd_io performs the IO submission, of writes in that same order.
  *
  * They must be separated as otherwise the final stages could be
  * starved by new requests which can block in the first stages due
@@ -727,7 +793,21 @@ static void kcryptd_io_read(struct dm_crypt_io *io)
 
 static void kcryptd_io_write(struct dm_crypt_io *io)
 {
+	struct crypt_config *cc = io->target->private;
 	struct bio *clone = io->ctx.bio_out;
+
+	/*
+	 * Failed clones only kept their place in the submission order
+	 */
+	if (unlikely(io->error)) {
+		if (clone) {
+			crypt_free_buffer_pages(cc, clone);
+			bio_put(clone);
+		}
+		crypt_dec_pending(io);
+		return;
+	}
+
 	generic_make_request(clone);
 }
 
@@ -749,82 +829,164 @@ static void kcryptd_queue_io(struct dm_crypt_io *io)
 	queue_work(cc->io_queue, &io->work);
 }
 
-static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
-					  int error, int async)
+/*
+ * Is clone a before clone b in the submission order?
+ */
+static int crypt_write_before(struct dm_crypt_io *a, struct dm_crypt_io *b)
+{
+	if (a->write_seq != b->write_seq)
+		return (int)(a->write_seq - b->write_seq) < 0;
+
+	return a->write_frag < b->write_frag;
+}
+
+/*
+ * Write clones are encrypted on all cpus and finish out of order, but
+ * kcryptd_io must see them in the order their bios were split.  Each
+ * clone is kept on write_list until all clones before it were queued.
+ */
+static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int error)
 {
 	struct bio *clone = io->ctx.bio_out;
 	struct crypt_config *cc = io->target->private;
+	struct dm_crypt_io *pos;
+	unsigned long flags;
 
 	if (unlikely(error < 0)) {
-		crypt_free_buffer_pages(cc, clone);
-		bio_put(clone);
-		io->error = -EIO;
-		crypt_dec_pending(io);
-		return;
+		if (!io->error)
+			io->error = -EIO;
+	} else if (!io->error) {
+		/* crypt_convert should have filled the clone bio */
+		BUG_ON(io->ctx.idx_out < clone->bi_vcnt);
+
+		clone->bi_sector = cc->start + io->sector;
 	}
 
-	/* crypt_convert should have filled the clone bio */
-	BUG_ON(io->ctx.idx_out < clone->bi_vcnt);
+	spin_lock_irqsave(&cc->write_lock, flags);
 
-	clone->bi_sector = cc->start + io->sector;
+	list_for_each_entry_reverse(pos, &cc->write_list, write_entry)
+		if (crypt_write_before(pos, io))
+			break;
+	list_add(&io->write_entry, &pos->write_entry);
+
+	while (!list_empty(&cc->write_list)) {
+		io = list_first_entry(&cc->write_list, struct dm_crypt_io,
+				      write_entry);
+		if (io->write_seq != cc->write_next_seq ||
+		    io->write_frag != cc->write_next_frag)
+			break;
+
+		list_del(&io->write_entry);
+		if (io->write_last) {
+			cc->write_next_seq++;
+			cc->write_next_frag = 0;
+		} else
+			cc->write_next_frag++;
 
-	if (async)
 		kcryptd_queue_io(io);
-	else
-		generic_make_request(clone);
+	}
+
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+/*
+ * Large bios are split in chunks of about the same size, one per online
+ * cpu, but not smaller than MIN_CHUNK_SIZE.
+ */
+static unsigned crypt_chunk_size(unsigned size)
+{
+	unsigned cpus = num_online_cpus();
+
+	if (cpus == 1)
+		return size;
+
+	return max_t(unsigned, ALIGN(DIV_ROUND_UP(size, cpus), PAGE_SIZE),
+		     MIN_CHUNK_SIZE);
+}
+
+static void kcryptd_crypt_write_chunk(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	int r;
+
+	crypt_inc_pending(io);
+	r = crypt_convert(cc, &io->ctx);
+
+	/* Encryption was already finished, submit io now */
+	if (atomic_dec_and_test(&io->ctx.pending))
+		kcryptd_crypt_write_io_submit(io, r);
 }
 
+/*
+ * Runs on write_queue, so that bios are split and numbered for submission
+ * in the order they arrived.  Buffers are allocated here too: a bio can
+ * only wait for pages held by bios before it, which never wait for it.
+ */
 static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->target->private;
+	struct bio *base_bio = io->base_bio;
 	struct bio *clone;
-	struct dm_crypt_io *new_io;
-	int crypt_finished;
+	struct dm_crypt_io *chunk_io;
 	unsigned out_of_pages = 0;
-	unsigned remaining = io->base_bio->bi_size;
+	unsigned remaining = base_bio->bi_size;
+	unsigned chunk = crypt_chunk_size(remaining);
+	unsigned int idx_in = base_bio->bi_idx, offset_in = 0;
+	unsigned int frag = 0;
 	sector_t sector = io->sector;
-	int r;
 
 	/*
 	 * Prevent io from disappearing until this function completes.
 	 */
 	crypt_inc_pending(io);
-	crypt_convert_init(cc, &io->ctx, NULL, io->base_bio, sector);
+	io->write_seq = cc->write_seq++;
 
 	/*
-	 * The allocated buffers can be smaller than the whole bio,
-	 * so repeat the whole process until all the data can be handled.
+	 * The allocated buffers can be smaller than the whole bio, and large
+	 * bios are split in chunks, so repeat the whole process until all
+	 * the data can be handled.  Every clone is encrypted by its own
+	 * dm_crypt_io on the next cpu.
 	 */
 	while (remaining) {
-		clone = crypt_alloc_buffer(io, remaining, &out_of_pages);
+		clone = crypt_alloc_buffer(io, min(remaining, chunk),
+					   &out_of_pages);
+
+		if (clone && !frag && clone->bi_size == remaining)
+			chunk_io = io;
+		else {
+			chunk_io = crypt_io_alloc(io->target, base_bio, sector,
+						  GFP_NOIO);
+			chunk_io->base_io = io;
+			crypt_inc_pending(io);
+		}
+		chunk_io->write_seq = io->write_seq;
+		chunk_io->write_frag = frag++;
+
 		if (unlikely(!clone)) {
-			io->error = -ENOMEM;
+			/*
+			 * Don't try next fragments, but let the clones of
+			 * the next bios be submitted.
+			 */
+			crypt_convert_init(cc, &chunk_io->ctx, NULL, base_bio,
+					   sector);
+			chunk_io->error = -ENOMEM;
+			chunk_io->write_last = 1;
+			crypt_inc_pending(chunk_io);
+			kcryptd_crypt_write_io_submit(chunk_io, 0);
 			break;
 		}
 
-		io->ctx.bio_out = clone;
-		io->ctx.idx_out = 0;
-
+		clone->bi_private = chunk_io;
 		remaining -= clone->bi_size;
-		sector += bio_sectors(clone);
-
-		crypt_inc_pending(io);
-		r = crypt_convert(cc, &io->ctx);
-		crypt_finished = atomic_dec_and_test(&io->ctx.pending);
+		chunk_io->write_last = !remaining;
 
-		/* Encryption was already finished, submit io now */
-		if (crypt_finished) {
-			kcryptd_crypt_write_io_submit(io, r, 0);
-
-			/*
-			 * If there was an error, do not try next fragments.
-			 * For async, error is processed in async handler.
-			 */
-			if (unlikely(r < 0))
-				break;
+		crypt_convert_init(cc, &chunk_io->ctx, clone, base_bio, sector);
+		chunk_io->ctx.idx_in = idx_in;
+		chunk_io->ctx.offset_in = offset_in;
+		crypt_advance(base_bio, &idx_in, &offset_in, clone->bi_size);
+		sector += bio_sectors(clone);
 
-			io->sector = sector;
-		}
+		kcryptd_queue_chunk(chunk_io);
 
 		/*
 		 * Out of memory -> run queues
@@ -832,34 +994,6 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 		 */
 		if (unlikely(out_of_pages))
 			congestion_wait(BLK_RW_ASYNC, HZ/100);
-
-		/*
-		 * With async crypto it is unsafe to share the crypto context
-		 * between fragments, so switch to a new dm_crypt_io structure.
-		 */
-		if (unlikely(!crypt_finished && remaining)) {
-			new_io = crypt_io_alloc(io->target, io->base_bio,
-						sector);
-			crypt_inc_pending(new_io);
-			crypt_convert_init(cc, &new_io->ctx, NULL,
-					   io->base_bio, sector);
-			new_io->ctx.idx_in = io->ctx.idx_in;
-			new_io->ctx.offset_in = io->ctx.offset_in;
-
-			/*
-			 * Fragments after the first use the base_io
-			 * pending count.
-			 */
-			if (!io->base_io)
-				new_io->base_io = io;
-			else {
-				new_io->base_io = io->base_io;
-				crypt_inc_pending(io->base_io);
-				crypt_dec_pending(io);
-			}
-
-			io = new_io;
-		}
 	}
 
 	crypt_dec_pending(io);
@@ -873,16 +1007,13 @@ static void kcryptd_crypt_read_done(struct dm_crypt_io *io, int error)
 	crypt_dec_pending(io);
 }
 
-static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
+static void kcryptd_crypt_read_chunk(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->target->private;
 	int r = 0;
 
 	crypt_inc_pending(io);
 
-	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
-			   io->sector);
-
 	r = crypt_convert(cc, &io->ctx);
 
 	if (atomic_dec_and_test(&io->ctx.pending))
@@ -891,6 +1022,52 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
+static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	struct bio *base_bio = io->base_bio;
+	struct dm_crypt_io *chunk_io;
+	unsigned chunk = crypt_chunk_size(base_bio->bi_size);
+	unsigned int idx = base_bio->bi_idx, start, bytes;
+	sector_t sector = io->sector;
+
+	/*
+	 * Split the bio at bio_vec boundaries and decrypt all chunks but
+	 * the last one on other cpus.  Waiting for an io here could stall
+	 * the conversions that free them, so just stop splitting instead.
+	 */
+	for (;;) {
+		start = idx;
+		for (bytes = 0; idx < base_bio->bi_vcnt && bytes < chunk; idx++)
+			bytes += bio_iovec_idx(base_bio, idx)->bv_len;
+
+		if (idx == base_bio->bi_vcnt)
+			break;
+
+		chunk_io = crypt_io_alloc(io->target, base_bio, sector,
+					  GFP_NOWAIT);
+		if (!chunk_io)
+			break;
+
+		chunk_io->base_io = io;
+		crypt_inc_pending(io);
+		crypt_inc_pending(chunk_io);
+
+		crypt_convert_init(cc, &chunk_io->ctx, base_bio, base_bio,
+				   sector);
+		chunk_io->ctx.idx_in = chunk_io->ctx.idx_out = start;
+		chunk_io->ctx.idx_in_end = idx;
+		kcryptd_queue_chunk(chunk_io);
+
+		sector += bytes >> SECTOR_SHIFT;
+	}
+
+	crypt_convert_init(cc, &io->ctx, base_bio, base_bio, sector);
+	io->ctx.idx_in = io->ctx.idx_out = start;
+
+	kcryptd_crypt_read_chunk(io);
+}
+
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error)
 {
@@ -912,7 +1089,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_done(io, error);
 	else
-		kcryptd_crypt_write_io_submit(io, error, 1);
+		kcryptd_crypt_write_io_submit(io, error);
 }
 
 static void kcryptd_crypt(struct work_struct *work)
@@ -925,12 +1102,53 @@ static void kcryptd_crypt(struct work_struct *work)
 		kcryptd_crypt_write_convert(io);
 }
 
+static void kcryptd_crypt_chunk(struct work_struct *work)
+{
+	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+
+	if (bio_data_dir(io->base_bio) == READ)
+		kcryptd_crypt_read_chunk(io);
+	else
+		kcryptd_crypt_write_chunk(io);
+}
+
+/*
+ * crypt_queue has a worker bound to each cpu: hand the work to the online
+ * cpus in turn.  Disabling preemption keeps the chosen cpu online until
+ * the work is queued.
+ */
+static void kcryptd_queue_crypt_on(struct dm_crypt_io *io, work_func_t func)
+{
+	struct crypt_config *cc = io->target->private;
+	int cpu;
+
+	INIT_WORK(&io->work, func);
+
+	get_cpu();
+	cpu = cpumask_next(ACCESS_ONCE(cc->crypt_cpu), cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(cpu_online_mask);
+	cc->crypt_cpu = cpu;
+	queue_work_on(cpu, cc->crypt_queue, &io->work);
+	put_cpu();
+}
+
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
+{
+	kcryptd_queue_crypt_on(io, kcryptd_crypt);
+}
+
+static void kcryptd_queue_chunk(struct dm_crypt_io *io)
+{
+	kcryptd_queue_crypt_on(io, kcryptd_crypt_chunk);
+}
+
+static void kcryptd_queue_write(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->target->private;
 
 	INIT_WORK(&io->work, kcryptd_crypt);
-	queue_work(cc->crypt_queue, &io->work);
+	queue_work(cc->write_queue, &io->work);
 }
 
 /*
@@ -1134,7 +1352,6 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		ti->error = "Cannot allocate crypt request mempool";
 		goto bad_req_pool;
 	}
-	cc->req = NULL;
 
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
@@ -1183,17 +1400,28 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad_io_queue;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	cc->write_queue = create_singlethread_workqueue("kcryptd_write");
+	if (!cc->write_queue) {
+		ti->error = "Couldn't create kcryptd write queue";
+		goto bad_write_queue;
+	}
+
+	cc->crypt_queue = create_workqueue("kcryptd");
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		goto bad_crypt_queue;
 	}
 
+	spin_lock_init(&cc->write_lock);
+	INIT_LIST_HEAD(&cc->write_list);
+
 	ti->num_flush_requests = 1;
 	ti->private = cc;
 	return 0;
 
 bad_crypt_queue:
+	destroy_workqueue(cc->write_queue);
+bad_write_queue:
 	destroy_workqueue(cc->io_queue);
 bad_io_queue:
 	kfree(cc->iv_mode);
@@ -1222,11 +1450,9 @@ static void crypt_dtr(struct dm_target *ti)
 {
 	struct crypt_config *cc = (struct crypt_config *) ti->private;
 
-	destroy_workqueue(cc->io_queue);
+	destroy_workqueue(cc->write_queue);
 	destroy_workqueue(cc->crypt_queue);
-
-	if (cc->req)
-		mempool_free(cc->req, cc->req_pool);
+	destroy_workqueue(cc->io_queue);
 
 	bioset_free(cc->bs);
 	mempool_destroy(cc->page_pool);
@@ -1255,12 +1481,12 @@ static int crypt_map(struct dm_target *ti, struct bio *bio,
 		return DM_MAPIO_REMAPPED;
 	}
 
-	io = crypt_io_alloc(ti, bio, bio->bi_sector - ti->begin);
+	io = crypt_io_alloc(ti, bio, bio->bi_sector - ti->begin, GFP_NOIO);
 
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_queue_io(io);
 	else
-		kcryptd_queue_crypt(io);
+		kcryptd_queue_write(io);
 
 	return DM_MAPIO_SUBMITTED;
 }
@@ -1393,7 +1619,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 7, 0},
+	.version = {1, 8, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -18,7 +18,12 @@
 #include <linux/uaccess.h>
 #include <linux/module.h>
 #include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <asm/sizes.h>
+#include <asm/tlbflush.h>
+#include <mach/dcache.h>
 
 #define MAX_INSTANCE_NAME_LENGTH 31
 
@@ -41,8 +46,17 @@ struct instance {
 
 	struct list_head alloc_list;
 
+#ifdef CONFIG_CMA
+	/*
+	 * The region is system RAM lent to the page allocator for movable
+	 * pages, which are migrated out when an alloc is made.
+	 */
+	bool movable;
+#endif /* #ifdef CONFIG_CMA */
+
 #ifdef CONFIG_DEBUG_FS
 	struct inode *debugfs_inode;
+	struct inode *debugfs_bench_inode;
 #endif /* #ifdef CONFIG_DEBUG_FS */
 };
 
@@ -57,6 +71,7 @@ void cona_free(void *instance, void *alloc);
 phys_addr_t cona_get_alloc_paddr(void *alloc);
 void *cona_get_alloc_kaddr(void *instance, void *alloc);
 size_t cona_get_alloc_size(void *alloc);
+void cona_set_alloc_pgprot(void *instance, void *alloc, pgprot_t pgprot);
 
 static int init_alloc_list(struct instance *instance);
 static void clean_alloc_list(struct instance *instance);
@@ -66,6 +81,15 @@ static struct alloc *split_allocation(struct alloc *alloc,
 							size_t new_alloc_size);
 static phys_addr_t get_alloc_offset(struct instance *instance,
 							struct alloc *alloc);
+#ifdef CONFIG_CMA
+static int init_movable(struct instance *instance);
+static struct alloc *alloc_movable(struct instance *instance, size_t size);
+static int take_movable_pages(struct alloc *alloc, size_t size,
+							phys_addr_t *paddr);
+static void flush_movable_pages(phys_addr_t paddr, size_t size);
+static void set_linear_pgprot(phys_addr_t paddr, size_t size,
+							pgprot_t pgprot);
+#endif /* #ifdef CONFIG_CMA */
 
 void *cona_create(const char *name, phys_addr_t region_paddr,
 							size_t region_size)
@@ -101,12 +125,22 @@ void *cona_create(const char *name, phys_addr_t region_paddr,
 	if (ret < 0)
 		goto init_alloc_list_failed;
 
+#ifdef CONFIG_CMA
+	ret = init_movable(instance);
+	if (ret < 0)
+		goto init_movable_failed;
+#endif /* #ifdef CONFIG_CMA */
+
 	mutex_lock(&lock);
 	list_add_tail(&instance->list, &instance_list);
 	mutex_unlock(&lock);
 
 	return instance;
 
+#ifdef CONFIG_CMA
+init_movable_failed:
+	clean_alloc_list(instance);
+#endif /* #ifdef CONFIG_CMA */
 init_alloc_list_failed:
 	vm_area = remove_vm_area(instance->region_kaddr);
 	if (vm_area == NULL)
@@ -130,6 +164,13 @@ void *cona_alloc(void *instance, size_t size)
 
 	mutex_lock(&lock);
 
+#ifdef CONFIG_CMA
+	if (instance_l->movable) {
+		alloc = alloc_movable(instance_l, size);
+		goto out;
+	}
+#endif /* #ifdef CONFIG_CMA */
+
 	alloc = find_free_alloc_bestfit(instance_l, size);
 	if (IS_ERR(alloc))
 		goto out;
@@ -155,6 +196,14 @@ void cona_free(void *instance, void *alloc)
 
 	mutex_lock(&lock);
 
+#ifdef CONFIG_CMA
+	if (instance_l->movable) {
+		set_linear_pgprot(alloc_l->paddr, alloc_l->size, PAGE_KERNEL);
+		free_contig_range(PFN_DOWN(alloc_l->paddr),
+						alloc_l->size >> PAGE_SHIFT);
+	}
+#endif /* #ifdef CONFIG_CMA */
+
 	alloc_l->in_use = false;
 
 	other = list_entry(alloc_l->list.prev, struct alloc, list);
@@ -194,6 +243,26 @@ size_t cona_get_alloc_size(void *alloc)
 	return ((struct alloc *)alloc)->size;
 }
 
+/*
+ * Allocs taken from system RAM are also mapped by the kernel's linear
+ * mapping, which must not be cacheable when hwmem maps the alloc uncached
+ * or write combined. cona_free() makes it cacheable again.
+ */
+void cona_set_alloc_pgprot(void *instance, void *alloc, pgprot_t pgprot)
+{
+#ifdef CONFIG_CMA
+	struct instance *instance_l = (struct instance *)instance;
+	struct alloc *alloc_l = (struct alloc *)alloc;
+
+	if (!instance_l->movable)
+		return;
+
+	set_linear_pgprot(alloc_l->paddr, alloc_l->size, pgprot);
+	/* Speculative fills may have come in until now */
+	flush_movable_pages(alloc_l->paddr, alloc_l->size);
+#endif /* #ifdef CONFIG_CMA */
+}
+
 static int init_alloc_list(struct instance *instance)
 {
 	/*
@@ -315,6 +384,171 @@ static phys_addr_t get_alloc_offset(struct instance *instance,
 	return alloc->paddr - instance->region_paddr;
 }
 
+#ifdef CONFIG_CMA
+
+static int init_movable(struct instance *instance)
+{
+	int ret;
+
+	/* Regions outside of system RAM are plain carveouts */
+	if (!pfn_valid(PFN_DOWN(instance->region_paddr)))
+		return 0;
+
+	/*
+	 * The region must have been reserved at boot, before anything could
+	 * allocate from it, and mapped with pages, see set_linear_pgprot().
+	 */
+	ret = init_cma_range(PFN_DOWN(instance->region_paddr),
+		PFN_DOWN(instance->region_paddr + instance->region_size));
+	if (ret < 0) {
+		printk(KERN_WARNING "CONA: Region in system RAM must be"
+			" reserved at boot and aligned to %lu bytes\n",
+			pageblock_nr_pages << PAGE_SHIFT);
+		return ret;
+	}
+
+	instance->movable = true;
+
+	printk(KERN_INFO "CONA: %s: %zu bytes usable for movable pages\n",
+					instance->name, instance->region_size);
+
+	return 0;
+}
+
+static struct alloc *alloc_movable(struct instance *instance, size_t size)
+{
+	struct alloc *alloc, *front, *back;
+	phys_addr_t paddr;
+
+	alloc = find_free_alloc_bestfit(instance, size);
+	if (IS_ERR(alloc))
+		return alloc;
+
+	front = kzalloc(sizeof(struct alloc), GFP_KERNEL);
+	back = kzalloc(sizeof(struct alloc), GFP_KERNEL);
+	if (front == NULL || back == NULL) {
+		alloc = ERR_PTR(-ENOMEM);
+		goto out;
+	}
+
+	/*
+	 * Pinned pages can keep the best fit from being freed, fall back to
+	 * the other free allocs then.
+	 */
+	if (take_movable_pages(alloc, size, &paddr) < 0) {
+		struct alloc *i;
+
+		alloc = ERR_PTR(-ENOMEM);
+		list_for_each_entry(i, &instance->alloc_list, list) {
+			if (i->in_use || i->size < size)
+				continue;
+			if (take_movable_pages(i, size, &paddr) == 0) {
+				alloc = i;
+				break;
+			}
+		}
+		if (IS_ERR(alloc))
+			goto out;
+	}
+
+	flush_movable_pages(paddr, size);
+
+	if (paddr > alloc->paddr) {
+		front->in_use = false;
+		front->paddr = alloc->paddr;
+		front->size = paddr - alloc->paddr;
+		list_add_tail(&front->list, &alloc->list);
+		alloc->paddr = paddr;
+		alloc->size -= front->size;
+		front = NULL;
+	}
+	if (size < alloc->size) {
+		back->in_use = false;
+		back->paddr = paddr + size;
+		back->size = alloc->size - size;
+		list_add(&back->list, &alloc->list);
+		alloc->size = size;
+		back = NULL;
+	}
+	alloc->in_use = true;
+
+out:
+	kfree(front);
+	kfree(back);
+
+	return alloc;
+}
+
+/*
+ * Takes size bytes of pages within the free alloc from the page allocator,
+ * migrating the movable pages placed there. The start of the alloc is tried
+ * first and then every pageblock boundary in it.
+ */
+static int take_movable_pages(struct alloc *alloc, size_t size,
+							phys_addr_t *paddr)
+{
+	const phys_addr_t pageblock_size = pageblock_nr_pages << PAGE_SHIFT;
+	phys_addr_t pos = alloc->paddr;
+
+	while (pos + size <= alloc->paddr + alloc->size) {
+		if (alloc_contig_range(PFN_DOWN(pos),
+					PFN_DOWN(pos + size)) == 0) {
+			*paddr = pos;
+			return 0;
+		}
+
+		pos = (pos + pageblock_size) & ~(pageblock_size - 1);
+	}
+
+	return -EBUSY;
+}
+
+/*
+ * The pages may have dirty lines in the CPU caches from their time in the
+ * page allocator, which must not end up in the alloc behind hwmem's back.
+ */
+static void flush_movable_pages(phys_addr_t paddr, size_t size)
+{
+	unsigned long pfn;
+
+	for (pfn = PFN_DOWN(paddr); pfn < PFN_DOWN(paddr + size); pfn++) {
+		bool flushed_everything;
+		void *vaddr = kmap_atomic(pfn_to_page(pfn), KM_USER0);
+
+		flush_cpu_dcache(vaddr, PFN_PHYS(pfn), PAGE_SIZE, false,
+							&flushed_everything);
+		kunmap_atomic(vaddr, KM_USER0);
+		if (flushed_everything)
+			break;
+	}
+}
+
+static int set_linear_pte(pte_t *pte, pgtable_t token, unsigned long addr,
+								void *data)
+{
+	pgprot_t *pgprot = data;
+
+	set_pte_at(&init_mm, addr, pte, pfn_pte(pte_pfn(*pte), *pgprot));
+
+	return 0;
+}
+
+/*
+ * Changes the memory type of the linear mapping of the pages, which the
+ * platform mapped with pages rather than sections for this, see
+ * map_lowmem_pages().
+ */
+static void set_linear_pgprot(phys_addr_t paddr, size_t size,
+							pgprot_t pgprot)
+{
+	unsigned long vaddr = (unsigned long)phys_to_virt(paddr);
+
+	apply_to_page_range(&init_mm, vaddr, size, set_linear_pte, &pgprot);
+	flush_tlb_kernel_range(vaddr, vaddr + size);
+}
+
+#endif /* #ifdef CONFIG_CMA */
+
 /* Debug */
 
 #ifdef CONFIG_DEBUG_FS
@@ -323,12 +557,19 @@ static int print_alloc(struct alloc *alloc, char **buf, size_t buf_size);
 static struct instance *get_instance_from_file(struct file *file);
 static int debugfs_allocs_read(struct file *filp, char __user *buf,
 						size_t count, loff_t *f_pos);
+static int debugfs_bench_read(struct file *filp, char __user *buf,
+						size_t count, loff_t *f_pos);
 
 static const struct file_operations debugfs_allocs_fops = {
 	.owner = THIS_MODULE,
 	.read  = debugfs_allocs_read,
 };
 
+static const struct file_operations debugfs_bench_fops = {
+	.owner = THIS_MODULE,
+	.read  = debugfs_bench_read,
+};
+
 static int print_alloc(struct alloc *alloc, char **buf, size_t buf_size)
 {
 	int ret;
@@ -360,7 +601,9 @@ static struct instance *get_instance_from_file(struct file *file)
 	struct instance *curr_instance;
 
 	list_for_each_entry(curr_instance, &instance_list, list) {
-		if (file->f_dentry->d_inode == curr_instance->debugfs_inode)
+		if (file->f_dentry->d_inode == curr_instance->debugfs_inode ||
+			file->f_dentry->d_inode ==
+					curr_instance->debugfs_bench_inode)
 			return curr_instance;
 	}
 
@@ -436,6 +679,82 @@ out:
 	return ret;
 }
 
+/*
+ * Reading <instance>_bench allocates and frees buffers of 1, 4 and 8 MiB and
+ * reports the allocation latencies. To measure the cost of migrating the
+ * movable pages out of the region, load the page cache first, e.g. by
+ * reading large files, and keep doing so while the benchmark runs.
+ */
+static int debugfs_bench_read(struct file *file, char __user *buf,
+						size_t count, loff_t *f_pos)
+{
+	static const size_t BENCH_SIZES[] = { SZ_1M, SZ_4M, SZ_8M };
+	static const unsigned int BENCH_ITERATIONS = 8;
+
+	int ret;
+	int i;
+	struct instance *instance;
+	char *local_buf;
+	size_t bytes_read = 0;
+
+	if (*f_pos != 0)
+		return 0;
+
+	mutex_lock(&lock);
+	instance = get_instance_from_file(file);
+	mutex_unlock(&lock);
+	if (IS_ERR(instance))
+		return PTR_ERR(instance);
+
+	local_buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (local_buf == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(BENCH_SIZES); i++) {
+		u64 min_us = ~(u64)0, max_us = 0, total_us = 0;
+		unsigned int j, done = 0, failed = 0;
+
+		for (j = 0; j < BENCH_ITERATIONS; j++) {
+			void *alloc;
+			ktime_t start = ktime_get();
+			u64 us;
+
+			alloc = cona_alloc(instance, BENCH_SIZES[i]);
+			us = ktime_us_delta(ktime_get(), start);
+			if (IS_ERR(alloc)) {
+				failed++;
+				continue;
+			}
+			cona_free(instance, alloc);
+
+			min_us = min(min_us, us);
+			max_us = max(max_us, us);
+			total_us += us;
+			done++;
+		}
+
+		bytes_read += scnprintf(local_buf + bytes_read,
+			PAGE_SIZE - bytes_read, "size: %5zu KiB\tmin: %8llu us\t"
+			"avg: %8llu us\tmax: %8llu us\tfailed: %u\n",
+			BENCH_SIZES[i] / SZ_1K, done ? min_us : 0,
+			done ? div_u64(total_us, done) : 0, max_us, failed);
+	}
+
+	bytes_read = min(bytes_read, count);
+	if (copy_to_user(buf, local_buf, bytes_read)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	*f_pos += bytes_read;
+	ret = bytes_read;
+
+out:
+	kfree(local_buf);
+
+	return ret;
+}
+
 static int __init init_debugfs(void)
 {
 	struct instance *curr_instance;
@@ -453,6 +772,15 @@ static int __init init_debugfs(void)
 				debugfs_root_dir, 0, &debugfs_allocs_fops);
 		if (file_dentry != NULL)
 			curr_instance->debugfs_inode = file_dentry->d_inode;
+
+		tmp_str[0] = '\0';
+		strcat(tmp_str, curr_instance->name);
+		strcat(tmp_str, "_bench");
+		file_dentry = debugfs_create_file(tmp_str, 0400,
+				debugfs_root_dir, 0, &debugfs_bench_fops);
+		if (file_dentry != NULL)
+			curr_instance->debugfs_bench_inode =
+							file_dentry->d_inode;
 	}
 
 	mutex_unlock(&lock);
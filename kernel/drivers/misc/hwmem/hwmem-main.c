@@ -182,6 +182,11 @@ static int kmap_alloc(struct hwmem_alloc *alloc)
 		return ret;
 	}
 
+	if (alloc->mem_type->allocator_api.set_alloc_pgprot != NULL)
+		alloc->mem_type->allocator_api.set_alloc_pgprot(
+			alloc->mem_type->allocator_instance,
+			alloc->allocator_hndl, pgprot);
+
 	alloc->kaddr = alloc_kaddr;
 
 	return 0;
@@ -16,6 +16,22 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Instead of scanning every task, victims are picked from an index of
+ * processes by oom_adj, kept up to date on fork, exit and oom_adj writes.
+ * Each oom_adj bucket is sorted by the rss cached at the last such event;
+ * the first few entries of a bucket have their rss refreshed when it is
+ * searched, so a process that grew or shrank since moves to its place.
+ *
+ * With /sys/module/lowmemorykiller/parameters/pressure_mode set, a process is
+ * only killed if, in addition, the reclaim pressure (the percentage of pages
+ * scanned by page reclaim that could not be freed, see mm/vmpressure.c) is
+ * at least pressure_min, and once a reclaim window has completed since the
+ * previous victim released its memory. Without a victim exiting, the next
+ * kill is delayed by kill_timeout_ms. The pressure level of the last window
+ * can be read from /dev/lowmemorykiller as "<low|medium|critical> <pressure>";
+ * poll() on it signals a change of level, so that user space can trim its
+ * caches before anything needs to be killed.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -35,6 +51,14 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/fs.h>
+#include <linux/vmpressure.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/lowmemorykiller.h>
 
 #define SEC_ADJUST_LMK
 
@@ -59,7 +83,35 @@ static size_t lowmem_minfree[6] = {
 static int lowmem_minfree_size = 6;
 
 static struct task_struct *lowmem_deathpending;
+/* the victim's signal_struct, only compared against, never dereferenced */
+static struct signal_struct *lowmem_deathpending_sig;
 static unsigned long lowmem_deathpending_timeout;
+static uint32_t lowmem_kill_timeout_ms = 1000;
+
+enum {
+	LOWMEM_PRESSURE_LOW,
+	LOWMEM_PRESSURE_MEDIUM,
+	LOWMEM_PRESSURE_CRITICAL,
+};
+
+static uint32_t lowmem_pressure_mode;
+static uint32_t lowmem_pressure_min = VMPRESSURE_CRITICAL;
+
+static DEFINE_SPINLOCK(lowmem_pressure_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_pressure_wait);
+static unsigned long lowmem_pressure;		/* of the last window */
+static unsigned long lowmem_pressure_stamp;	/* jiffies at its end */
+static unsigned int lowmem_pressure_windows;	/* windows completed */
+static unsigned int lowmem_freed_window;	/* ... when the victim exited */
+static int lowmem_pressure_cur_level;
+static unsigned int lowmem_pressure_events;	/* changes of level */
+
+/* number of entries of a bucket whose rss is refreshed per search */
+#define LOWMEM_PROBE	4
+
+/* signal_structs of live processes by oom_adj, largest cached rss first */
+static struct list_head lowmem_index[OOM_ADJUST_MAX - OOM_DISABLE + 1];
+static DEFINE_SPINLOCK(lowmem_index_lock);
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -85,16 +137,192 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	return NOTIFY_OK;
 }
 
-static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
+static unsigned long lowmem_task_rss(struct task_struct *p)
 {
-	struct task_struct *p;
+	unsigned long rss = 0;
+
+	task_lock(p);
+	if (p->mm)
+		rss = get_mm_rss(p->mm);
+	task_unlock(p);
+
+	return rss;
+}
+
+/* Called with lowmem_index_lock held */
+static void lowmem_index_insert(struct signal_struct *sig)
+{
+	struct list_head *head = &lowmem_index[sig->lmk_adj - OOM_DISABLE];
+	struct signal_struct *pos;
+
+	list_for_each_entry(pos, head, lmk_node) {
+		if (pos->lmk_rss <= sig->lmk_rss)
+			break;
+	}
+	list_add_tail(&sig->lmk_node, &pos->lmk_node);
+}
+
+static int
+lowmem_oom_adj_notify(struct notifier_block *self, unsigned long event,
+		      void *data)
+{
+	struct task_struct *p = data;
+	struct signal_struct *sig = p->signal;
+	unsigned long rss = 0;
+
+	if (event != OOM_ADJ_EXIT)
+		rss = lowmem_task_rss(p);
+	else if (sig == lowmem_deathpending_sig) {
+		/* the victim's memory is back, reclaim may go on */
+		spin_lock(&lowmem_pressure_lock);
+		lowmem_freed_window = lowmem_pressure_windows;
+		spin_unlock(&lowmem_pressure_lock);
+		lowmem_deathpending_sig = NULL;
+		lowmem_deathpending = NULL;
+	}
+
+	spin_lock(&lowmem_index_lock);
+	list_del_init(&sig->lmk_node);
+	/*
+	 * An oom_adj write may race with the exit of the process; once
+	 * 'live' dropped to zero its OOM_ADJ_EXIT has run or is waiting
+	 * for the lock, so it must not be indexed again.
+	 */
+	if (event != OOM_ADJ_EXIT && atomic_read(&sig->live)) {
+		sig->lmk_adj = sig->oom_adj;
+		sig->lmk_rss = rss;
+		lowmem_index_insert(sig);
+	}
+	spin_unlock(&lowmem_index_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_oom_adj_nb = {
+	.notifier_call	= lowmem_oom_adj_notify,
+};
+
+static int lowmem_pressure_level(unsigned long pressure)
+{
+	if (pressure >= VMPRESSURE_CRITICAL)
+		return LOWMEM_PRESSURE_CRITICAL;
+	if (pressure >= VMPRESSURE_MEDIUM)
+		return LOWMEM_PRESSURE_MEDIUM;
+	return LOWMEM_PRESSURE_LOW;
+}
+
+static int
+lowmem_vmpressure_notify(struct notifier_block *self, unsigned long pressure,
+			 void *data)
+{
+	int level = lowmem_pressure_level(pressure);
+
+	spin_lock(&lowmem_pressure_lock);
+	lowmem_pressure = pressure;
+	lowmem_pressure_stamp = jiffies;
+	lowmem_pressure_windows++;
+	if (level != lowmem_pressure_cur_level) {
+		lowmem_pressure_cur_level = level;
+		lowmem_pressure_events++;
+		wake_up_interruptible(&lowmem_pressure_wait);
+	}
+	spin_unlock(&lowmem_pressure_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call	= lowmem_vmpressure_notify,
+};
+
+/*
+ * In pressure mode, whether reclaim is failing badly enough to kill:
+ * a window must have completed since the last victim exited, so that
+ * the memory it released was taken into account, and the pressure of
+ * the last window, if recent, must be at least lowmem_pressure_min.
+ */
+static bool lowmem_pressure_kill(void)
+{
+	unsigned long pressure = 0;
+	bool fresh;
+
+	spin_lock(&lowmem_pressure_lock);
+	fresh = lowmem_pressure_windows != lowmem_freed_window;
+	if (time_before_eq(jiffies, lowmem_pressure_stamp + HZ))
+		pressure = lowmem_pressure;
+	spin_unlock(&lowmem_pressure_lock);
+
+	lowmem_print(3, "lowmem_shrink pressure %lu%s\n", pressure,
+		     fresh ? "" : ", waiting for reclaim");
+	return fresh && pressure >= lowmem_pressure_min;
+}
+
+/*
+ * Return the process to kill, with a reference held: the one with the
+ * largest rss among the first LOWMEM_PROBE of the highest non-empty
+ * oom_adj bucket at or above min_adj.
+ */
+static struct task_struct *lowmem_select(int min_adj, int *oom_adj,
+					 int *tasksize)
+{
+	struct signal_struct *probed[LOWMEM_PROBE];
 	struct task_struct *selected = NULL;
+	struct signal_struct *sig;
+	int adj, nr, i;
+
+	*tasksize = 0;
+	if (min_adj < OOM_DISABLE)
+		min_adj = OOM_DISABLE;
+
+	spin_lock(&lowmem_index_lock);
+	rcu_read_lock();
+	for (adj = OOM_ADJUST_MAX; adj >= min_adj && !selected; adj--) {
+		nr = 0;
+		list_for_each_entry(sig, &lowmem_index[adj - OOM_DISABLE],
+				    lmk_node) {
+			struct task_struct *p;
+			unsigned long rss;
+
+			p = pid_task(sig->leader_pid, PIDTYPE_PID);
+			if (!p)
+				continue;
+			rss = lowmem_task_rss(p);
+			sig->lmk_rss = rss;
+			probed[nr++] = sig;
+			if (rss > *tasksize) {
+				selected = p;
+				*tasksize = rss;
+				*oom_adj = adj;
+				lowmem_print(2, "select %d (%s), adj %d, "
+					     "size %lu, to kill\n",
+					     p->pid, p->comm, adj, rss);
+			}
+			if (nr == LOWMEM_PROBE)
+				break;
+		}
+		/* keep the bucket sorted by the refreshed sizes */
+		for (i = 0; i < nr; i++) {
+			list_del(&probed[i]->lmk_node);
+			lowmem_index_insert(probed[i]);
+		}
+	}
+	if (selected)
+		get_task_struct(selected);
+	rcu_read_unlock();
+	spin_unlock(&lowmem_index_lock);
+
+	return selected;
+}
+
+static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
+{
+	struct task_struct *selected;
 	int rem = 0;
-	int tasksize;
 	int i;
 	int min_adj = OOM_ADJUST_MAX + 1;
-	int selected_tasksize = 0;
+	int selected_tasksize;
 	int selected_oom_adj;
+	u64 start;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES);
 	#ifdef SEC_ADJUST_LMK
@@ -144,57 +372,36 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 			     nr_to_scan, gfp_mask, rem);
 		return rem;
 	}
+	if (lowmem_pressure_mode && !lowmem_pressure_kill())
+		return -1;
 	selected_oom_adj = min_adj;
 
-	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
-
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
-	}
+	start = sched_clock();
+	selected = lowmem_select(min_adj, &selected_oom_adj,
+				 &selected_tasksize);
+	trace_lowmem_select(min_adj, selected, selected_oom_adj,
+			    selected_tasksize, sched_clock() - start);
+
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_adj, selected_tasksize);
-		lowmem_deathpending = selected;
-		lowmem_deathpending_timeout = jiffies + HZ;
-		force_sig(SIGKILL, selected);
+		read_lock(&tasklist_lock);
+		if (pid_alive(selected)) {
+			lowmem_deathpending = selected;
+			lowmem_deathpending_sig = selected->signal;
+			lowmem_deathpending_timeout = jiffies +
+				msecs_to_jiffies(lowmem_kill_timeout_ms);
+			force_sig(SIGKILL, selected);
+		}
+		read_unlock(&tasklist_lock);
+		put_task_struct(selected);
 		rem -= selected_tasksize;
 	} else
 		rem = -1;
 	
 	lowmem_print(4, "lowmem_shrink %d, %x, return %d\n",
 		     nr_to_scan, gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
@@ -203,9 +410,76 @@ static struct shrinker lowmem_shrinker = {
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+/*
+ * A file remembers in private_data the number of level changes it has
+ * seen, updated whenever it is read from the start.
+ */
+static int lowmem_pressure_open(struct inode *inode, struct file *file)
+{
+	file->private_data = (void *)(unsigned long)lowmem_pressure_events;
+	return 0;
+}
+
+static ssize_t lowmem_pressure_read(struct file *file, char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	static const char * const names[] = { "low", "medium", "critical" };
+	unsigned long pressure;
+	unsigned int events;
+	char tmp[24];
+	int len;
+
+	spin_lock(&lowmem_pressure_lock);
+	pressure = lowmem_pressure;
+	events = lowmem_pressure_events;
+	spin_unlock(&lowmem_pressure_lock);
+
+	if (*ppos == 0)
+		file->private_data = (void *)(unsigned long)events;
+	len = snprintf(tmp, sizeof(tmp), "%s %lu\n",
+		       names[lowmem_pressure_level(pressure)], pressure);
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static unsigned int lowmem_pressure_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &lowmem_pressure_wait, wait);
+	if ((unsigned long)file->private_data != lowmem_pressure_events)
+		return POLLIN | POLLRDNORM | POLLPRI;
+	return 0;
+}
+
+static const struct file_operations lowmem_pressure_fops = {
+	.owner = THIS_MODULE,
+	.open = lowmem_pressure_open,
+	.read = lowmem_pressure_read,
+	.poll = lowmem_pressure_poll,
+};
+
+static struct miscdevice lowmem_pressure_dev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "lowmemorykiller",
+	.fops = &lowmem_pressure_fops,
+};
+
 static int __init lowmem_init(void)
 {
+	struct task_struct *p;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(lowmem_index); i++)
+		INIT_LIST_HEAD(&lowmem_index[i]);
+	register_oom_adj_notifier(&lowmem_oom_adj_nb);
+	/* index the processes that were forked before us */
+	read_lock(&tasklist_lock);
+	for_each_process(p)
+		lowmem_oom_adj_notify(NULL, OOM_ADJ_CHANGE, p);
+	read_unlock(&tasklist_lock);
 	task_free_register(&task_nb);
+	register_vmpressure_notifier(&lowmem_vmpressure_nb);
+	if (misc_register(&lowmem_pressure_dev))
+		printk(KERN_ERR "lowmemorykiller: failed to register "
+		       "pressure device\n");
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
@@ -213,7 +487,10 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	misc_deregister(&lowmem_pressure_dev);
+	unregister_vmpressure_notifier(&lowmem_vmpressure_nb);
 	task_free_unregister(&task_nb);
+	unregister_oom_adj_notifier(&lowmem_oom_adj_nb);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -222,6 +499,11 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(kill_timeout_ms, lowmem_kill_timeout_ms, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_mode, lowmem_pressure_mode, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_min, lowmem_pressure_min, uint, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
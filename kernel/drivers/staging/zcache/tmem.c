@@ -25,6 +25,7 @@
  */
 
 #include <linux/list.h>
+#include <linux/module.h>
 #include <linux/spinlock.h>
 #include <asm/atomic.h>
 
@@ -48,6 +49,7 @@ void tmem_register_hostops(struct tmem_hostops *m)
 	tmem_objnode_tree_init();
 	tmem_hostops = *m;
 }
+EXPORT_SYMBOL_GPL(tmem_register_hostops);
 
 /*
  * A tmem host implementation must use this function to register
@@ -59,6 +61,7 @@ void tmem_register_pamops(struct tmem_pamops *m)
 {
 	tmem_pamops = *m;
 }
+EXPORT_SYMBOL_GPL(tmem_register_pamops);
 
 /*
  * Oid's are potentially very sparse and tmem_objs may have an indeterminately
@@ -560,6 +563,7 @@ out:
 	spin_unlock(&hb->lock);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(tmem_put);
 
 /*
  * "Get" a page, e.g. if one can be found, copy the tmem page with the
@@ -610,6 +614,7 @@ out:
 	spin_unlock(&hb->lock);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(tmem_get);
 
 /*
  * If a page in tmem matches the handle, "flush" this page from tmem such
@@ -643,6 +648,7 @@ out:
 	spin_unlock(&hb->lock);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(tmem_flush_page);
 
 /*
  * "Flush" all pages in tmem matching this oid.
@@ -667,6 +673,7 @@ out:
 	spin_unlock(&hb->lock);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(tmem_flush_object);
 
 /*
  * "Flush" all pages (and tmem_objs) from this tmem_pool and disable
@@ -683,6 +690,7 @@ int tmem_destroy_pool(struct tmem_pool *pool)
 out:
 	return ret;
 }
+EXPORT_SYMBOL_GPL(tmem_destroy_pool);
 
 static LIST_HEAD(tmem_global_pool_list);
 
@@ -708,3 +716,6 @@ void tmem_new_pool(struct tmem_pool *pool, uint32_t flags)
 	pool->persistent = persistent;
 	pool->shared = shared;
 }
+EXPORT_SYMBOL_GPL(tmem_new_pool);
+
+MODULE_LICENSE("GPL");
@@ -6,11 +6,13 @@
  *
  * Zcache provides an in-kernel "host implementation" for transcendent memory
  * and, thus indirectly, for cleancache and frontswap.  Zcache includes two
- * page-accessible memory [1] interfaces, both utilizing lzo1x compression:
+ * page-accessible memory [1] interfaces, both utilizing a crypto API
+ * compressor (lzo by default):
  * 1) "compression buddies" ("zbud") is used for ephemeral pages
- * 2) xvmalloc is used for persistent pages.
- * Xvmalloc (based on the TLSF allocator) has very low fragmentation
- * so maximizes space efficiency, while zbud allows pairs (and potentially,
+ * 2) zsmalloc is used for persistent pages.
+ * Zsmalloc has very low fragmentation so maximizes space efficiency, and
+ * its oldest pages are written back to the swap device under memory
+ * pressure or when the pool is full, while zbud allows pairs (and potentially,
  * in the future, more than a pair of) compressed pages to be closely linked
  * so that reclaiming can be done via the kernel's physical-page-oriented
  * "shrinker" interface.
@@ -20,16 +22,20 @@
  */
 
 #include <linux/cpu.h>
+#include <linux/crypto.h>
 #include <linux/highmem.h>
 #include <linux/list.h>
-#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #include <asm/atomic.h>
 #include "tmem.h"
 
-#include "../zram/xvmalloc.h" /* if built in drivers/staging */
+#include "../zsmalloc/zsmalloc.h" /* if built in drivers/staging */
 
 #if (!defined(CONFIG_CLEANCACHE) && !defined(CONFIG_FRONTSWAP))
 #error "zcache is useless without CONFIG_CLEANCACHE or CONFIG_FRONTSWAP"
@@ -41,6 +47,16 @@
 #include <linux/frontswap.h>
 #endif
 
+/*
+ * The compressor is any crypto API compression algorithm (lzo, lz4,
+ * snappy, deflate, ...), selected with the "zcache=<name>" boot parameter or the
+ * "compressor" module parameter. Each cpu has its own transform.
+ */
+static char zcache_comp_name[CRYPTO_MAX_ALG_NAME] = "lzo";
+module_param_string(compressor, zcache_comp_name, sizeof(zcache_comp_name),
+			0444);
+static DEFINE_PER_CPU(struct crypto_comp *, zcache_comp_tfm);
+
 #if 0
 /* this is more aggressive but may cause other problems? */
 #define ZCACHE_GFP_MASK	(GFP_ATOMIC | __GFP_NORETRY | __GFP_NOWARN)
@@ -121,6 +137,26 @@ static unsigned long zcache_zbud_cumul_zpages;
 static unsigned long zcache_zbud_cumul_zbytes;
 static unsigned long zcache_compress_poor;
 
+#define MAX_POOLS_PER_CLIENT 16
+
+/*
+ * Per-pool statistics, in /sys/kernel/mm/zcache/pool<id>/. The chunk
+ * counts show how full the zbuds of an ephemeral pool are.
+ */
+struct zcache_pool_stats {
+	struct kobject kobj;
+	bool persistent;
+	unsigned long compressed;	/* pages compressed */
+	unsigned long compr_bytes;	/* their total compressed size */
+	unsigned long compress_poor;
+	unsigned long decompressed;
+	u64 compress_ns;
+	u64 decompress_ns;
+	unsigned long zbud_chunk_counts[NCHUNKS];
+};
+
+static struct zcache_pool_stats *zcache_pool_stats[MAX_POOLS_PER_CLIENT];
+
 /* forward references */
 static void *zcache_get_free_page(void);
 static void zcache_free_page(void *p);
@@ -360,6 +396,7 @@ init_zh:
 	memcpy(to, cdata, size);
 	spin_unlock(&zbpg->lock);
 	zbud_cumul_chunk_counts[nchunks]++;
+	zcache_pool_stats[pool_id]->zbud_chunk_counts[nchunks]++;
 	atomic_inc(&zcache_zbud_curr_zpages);
 	zcache_zbud_cumul_zpages++;
 	zcache_zbud_curr_zbytes += size;
@@ -368,11 +405,14 @@ out:
 	return zh;
 }
 
+static int zcache_decompress(const void *src, unsigned int slen, void *dst,
+				unsigned int *dlen);
+
 static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 {
 	struct zbud_page *zbpg;
 	unsigned budnum = zbud_budnum(zh);
-	size_t out_len = PAGE_SIZE;
+	unsigned int out_len = PAGE_SIZE;
 	char *to_va, *from_va;
 	unsigned size;
 	int ret = 0;
@@ -389,8 +429,8 @@ static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 	to_va = kmap_atomic(page, KM_USER0);
 	size = zh->size;
 	from_va = zbud_data(zh, size);
-	ret = lzo1x_decompress_safe(from_va, size, to_va, &out_len);
-	BUG_ON(ret != LZO_E_OK);
+	ret = zcache_decompress(from_va, size, to_va, &out_len);
+	BUG_ON(ret != 0);
 	BUG_ON(out_len != PAGE_SIZE);
 	kunmap_atomic(to_va, KM_USER0);
 out:
@@ -558,7 +598,7 @@ static int zbud_show_unbuddied_list_counts(char *buf)
 	return p - buf;
 }
 
-static int zbud_show_cumul_chunk_counts(char *buf)
+static int zbud_show_chunk_counts(const unsigned long *counts, char *buf)
 {
 	unsigned long i, chunks = 0, total_chunks = 0, sum_total_chunks = 0;
 	unsigned long total_chunks_lte_21 = 0, total_chunks_lte_32 = 0;
@@ -566,10 +606,10 @@ static int zbud_show_cumul_chunk_counts(char *buf)
 	char *p = buf;
 
 	for (i = 0; i < NCHUNKS; i++) {
-		p += sprintf(p, "%lu ", zbud_cumul_chunk_counts[i]);
-		chunks += zbud_cumul_chunk_counts[i];
-		total_chunks += zbud_cumul_chunk_counts[i];
-		sum_total_chunks += i * zbud_cumul_chunk_counts[i];
+		p += sprintf(p, "%lu ", counts[i]);
+		chunks += counts[i];
+		total_chunks += counts[i];
+		sum_total_chunks += i * counts[i];
 		if (i == 21)
 			total_chunks_lte_21 = total_chunks;
 		if (i == 32)
@@ -582,15 +622,22 @@ static int zbud_show_cumul_chunk_counts(char *buf)
 		chunks == 0 ? 0 : sum_total_chunks / chunks);
 	return p - buf;
 }
+
+static int zbud_show_cumul_chunk_counts(char *buf)
+{
+	return zbud_show_chunk_counts(zbud_cumul_chunk_counts, buf);
+}
 #endif
 
 /**********
- * This "zv" PAM implementation combines the TLSF-based xvMalloc
- * with lzo1x compression to maximize the amount of data that can
- * be packed into a physical page.
+ * This "zv" PAM implementation combines zsmalloc with compression
+ * to maximize the amount of data that can be packed into a physical page.
  *
  * Zv represents a PAM page with the index and object (plus a "size" value
  * necessary for decompression) immediately preceding the compressed data.
+ * As zsmalloc hands out handles rather than pointers, each zv is tracked
+ * by a small zv_entry, which also keeps it on an LRU list of the pages
+ * least recently put or gotten, for writeback to the swap device.
  */
 
 #define ZVH_SENTINEL  0x43214321
@@ -599,70 +646,111 @@ struct zv_hdr {
 	uint32_t pool_id;
 	struct tmem_oid oid;
 	uint32_t index;
+	uint16_t size; /* compressed size in bytes */
 	DECL_SENTINEL
 };
 
+struct zv_entry {
+	struct list_head lru;
+	void *handle;
+};
+
 static const int zv_max_page_size = (PAGE_SIZE / 8) * 7;
 
-static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
+static struct kmem_cache *zcache_zv_cache;
+
+/* oldest first; the lock also keeps the handles of listed zvs valid */
+static LIST_HEAD(zv_lru);
+static DEFINE_SPINLOCK(zv_lru_lock);
+
+static unsigned long zcache_writeback_pages;
+static unsigned long zcache_writeback_failed;
+
+/* pages written back per batch when the pool is full */
+#define ZCACHE_WB_BATCH		32
+
+#ifdef CONFIG_FRONTSWAP
+static void zcache_frontswap_writeback_kick(int nr);
+#else
+static inline void zcache_frontswap_writeback_kick(int nr)
+{
+}
+#endif
+
+static struct zv_entry *zv_create(struct zs_pool *zspool, uint32_t pool_id,
 				struct tmem_oid *oid, uint32_t index,
 				void *cdata, unsigned clen)
 {
-	struct page *page;
-	struct zv_hdr *zv = NULL;
-	uint32_t offset;
-	int ret;
+	struct zv_entry *zve;
+	struct zv_hdr *zv;
+	unsigned long flags;
 
 	BUG_ON(!irqs_disabled());
-	ret = xv_malloc(xvpool, clen + sizeof(struct zv_hdr),
-			&page, &offset, ZCACHE_GFP_MASK);
-	if (unlikely(ret))
+	zve = kmem_cache_alloc(zcache_zv_cache, ZCACHE_GFP_MASK);
+	if (unlikely(zve == NULL))
 		goto out;
-	zv = kmap_atomic(page, KM_USER0) + offset;
+	zve->handle = zs_malloc(zspool, clen + sizeof(struct zv_hdr),
+				ZCACHE_GFP_MASK);
+	if (unlikely(zve->handle == NULL)) {
+		kmem_cache_free(zcache_zv_cache, zve);
+		zve = NULL;
+		goto out;
+	}
+	zv = zs_map_object(zspool, zve->handle);
 	zv->index = index;
 	zv->oid = *oid;
 	zv->pool_id = pool_id;
+	zv->size = clen;
 	SET_SENTINEL(zv, ZVH);
 	memcpy((char *)zv + sizeof(struct zv_hdr), cdata, clen);
-	kunmap_atomic(zv, KM_USER0);
+	zs_unmap_object(zspool, zve->handle);
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	list_add_tail(&zve->lru, &zv_lru);
+	spin_unlock_irqrestore(&zv_lru_lock, flags);
 out:
-	return zv;
+	return zve;
 }
 
-static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
+static void zv_free(struct zs_pool *zspool, struct zv_entry *zve)
 {
 	unsigned long flags;
-	struct page *page;
-	uint32_t offset;
-	uint16_t size;
+	struct zv_hdr *zv;
 
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	list_del(&zve->lru);
+	spin_unlock_irqrestore(&zv_lru_lock, flags);
+	zv = zs_map_object(zspool, zve->handle);
 	ASSERT_SENTINEL(zv, ZVH);
-	size = xv_get_object_size(zv) - sizeof(*zv);
-	BUG_ON(size == 0 || size > zv_max_page_size);
+	BUG_ON(zv->size == 0 || zv->size > zv_max_page_size);
 	INVERT_SENTINEL(zv, ZVH);
-	page = virt_to_page(zv);
-	offset = (unsigned long)zv & ~PAGE_MASK;
-	local_irq_save(flags);
-	xv_free(xvpool, page, offset);
-	local_irq_restore(flags);
+	zs_unmap_object(zspool, zve->handle);
+	zs_free(zspool, zve->handle);
+	kmem_cache_free(zcache_zv_cache, zve);
 }
 
-static void zv_decompress(struct page *page, struct zv_hdr *zv)
+static void zv_decompress(struct zs_pool *zspool, struct page *page,
+				struct zv_entry *zve)
 {
-	size_t clen = PAGE_SIZE;
+	unsigned int clen = PAGE_SIZE;
+	unsigned long flags;
+	struct zv_hdr *zv;
 	char *to_va;
 	unsigned size;
 	int ret;
 
+	zv = zs_map_object(zspool, zve->handle);
 	ASSERT_SENTINEL(zv, ZVH);
-	size = xv_get_object_size(zv) - sizeof(*zv);
+	size = zv->size;
 	BUG_ON(size == 0 || size > zv_max_page_size);
 	to_va = kmap_atomic(page, KM_USER0);
-	ret = lzo1x_decompress_safe((char *)zv + sizeof(*zv),
-					size, to_va, &clen);
+	ret = zcache_decompress((char *)zv + sizeof(*zv), size, to_va, &clen);
 	kunmap_atomic(to_va, KM_USER0);
-	BUG_ON(ret != LZO_E_OK);
+	zs_unmap_object(zspool, zve->handle);
+	BUG_ON(ret != 0);
 	BUG_ON(clen != PAGE_SIZE);
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	list_move_tail(&zve->lru, &zv_lru);
+	spin_unlock_irqrestore(&zv_lru_lock, flags);
 }
 
 /*
@@ -677,11 +765,9 @@ static unsigned long zcache_flobj_found;
 static unsigned long zcache_failed_eph_puts;
 static unsigned long zcache_failed_pers_puts;
 
-#define MAX_POOLS_PER_CLIENT 16
-
 static struct {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
-	struct xv_pool *xvpool;
+	struct zs_pool *zspool;
 } zcache_client;
 
 /*
@@ -900,22 +986,34 @@ static unsigned long zcache_curr_pers_pampd_count_max;
 /* forward reference */
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len);
 
+static void zcache_pool_stats_compressed(struct zcache_pool_stats *stats,
+					 size_t clen, u64 start)
+{
+	stats->compress_ns += sched_clock() - start;
+	stats->compressed++;
+	stats->compr_bytes += clen;
+}
+
 static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 				 uint32_t index, struct page *page)
 {
+	struct zcache_pool_stats *stats = zcache_pool_stats[pool->pool_id];
 	void *pampd = NULL, *cdata;
 	size_t clen;
 	int ret;
 	bool ephemeral = is_ephemeral(pool);
 	unsigned long count;
+	u64 start;
 
 	if (ephemeral) {
+		start = sched_clock();
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
-
 			goto out;
+		zcache_pool_stats_compressed(stats, clen, start);
 		if (clen == 0 || clen > zbud_max_buddy_size()) {
 			zcache_compress_poor++;
+			stats->compress_poor++;
 			goto out;
 		}
 		pampd = (void *)zbud_create(pool->pool_id, oid, index,
@@ -932,16 +1030,22 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 		 * compressed frontswap pages
 		 */
 		if (atomic_read(&zcache_curr_pers_pampd_count) >
-							3 * totalram_pages / 4)
+							3 * totalram_pages / 4) {
+			/* make room for the next ones */
+			zcache_frontswap_writeback_kick(ZCACHE_WB_BATCH);
 			goto out;
+		}
+		start = sched_clock();
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
 			goto out;
+		zcache_pool_stats_compressed(stats, clen, start);
 		if (clen > zv_max_page_size) {
 			zcache_compress_poor++;
+			stats->compress_poor++;
 			goto out;
 		}
-		pampd = (void *)zv_create(zcache_client.xvpool, pool->pool_id,
+		pampd = (void *)zv_create(zcache_client.zspool, pool->pool_id,
 						oid, index, cdata, clen);
 		if (pampd == NULL)
 			goto out;
@@ -960,12 +1064,18 @@ out:
 static int zcache_pampd_get_data(struct page *page, void *pampd,
 						struct tmem_pool *pool)
 {
+	struct zcache_pool_stats *stats = zcache_pool_stats[pool->pool_id];
+	u64 start = sched_clock();
 	int ret = 0;
 
 	if (is_ephemeral(pool))
 		ret = zbud_decompress(page, pampd);
 	else
-		zv_decompress(page, pampd);
+		zv_decompress(zcache_client.zspool, page, pampd);
+	if (ret == 0) {
+		stats->decompress_ns += sched_clock() - start;
+		stats->decompressed++;
+	}
 	return ret;
 }
 
@@ -980,7 +1090,7 @@ static void zcache_pampd_free(void *pampd, struct tmem_pool *pool)
 		atomic_dec(&zcache_curr_eph_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 	} else {
-		zv_free(zcache_client.xvpool, (struct zv_hdr *)pampd);
+		zv_free(zcache_client.zspool, (struct zv_entry *)pampd);
 		atomic_dec(&zcache_curr_pers_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_pers_pampd_count) < 0);
 	}
@@ -996,55 +1106,77 @@ static struct tmem_pamops zcache_pamops = {
  * zcache compression/decompression and related per-cpu stuff
  */
 
-#define LZO_WORKMEM_BYTES LZO1X_1_MEM_COMPRESS
-#define LZO_DSTMEM_PAGE_ORDER 1
-static DEFINE_PER_CPU(unsigned char *, zcache_workmem);
+#define ZCACHE_DSTMEM_PAGE_ORDER 1
 static DEFINE_PER_CPU(unsigned char *, zcache_dstmem);
 
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len)
 {
 	int ret = 0;
 	unsigned char *dmem = __get_cpu_var(zcache_dstmem);
-	unsigned char *wmem = __get_cpu_var(zcache_workmem);
+	struct crypto_comp *tfm = __get_cpu_var(zcache_comp_tfm);
+	unsigned int dlen = PAGE_SIZE << ZCACHE_DSTMEM_PAGE_ORDER;
 	char *from_va;
 
 	BUG_ON(!irqs_disabled());
-	if (unlikely(dmem == NULL || wmem == NULL))
+	if (unlikely(dmem == NULL || tfm == NULL))
 		goto out;  /* no buffer, so can't compress */
 	from_va = kmap_atomic(from, KM_USER0);
 	mb();
-	ret = lzo1x_1_compress(from_va, PAGE_SIZE, dmem, out_len, wmem);
-	BUG_ON(ret != LZO_E_OK);
-	*out_va = dmem;
+	ret = crypto_comp_compress(tfm, from_va, PAGE_SIZE, dmem, &dlen);
 	kunmap_atomic(from_va, KM_USER0);
+	if (unlikely(ret)) {
+		ret = 0;
+		goto out;
+	}
+	*out_va = dmem;
+	*out_len = dlen;
 	ret = 1;
 out:
 	return ret;
 }
 
+static int zcache_decompress(const void *src, unsigned int slen, void *dst,
+				unsigned int *dlen)
+{
+	int ret;
+
+	ret = crypto_comp_decompress(get_cpu_var(zcache_comp_tfm),
+					src, slen, dst, dlen);
+	put_cpu_var(zcache_comp_tfm);
+	return ret;
+}
+
 
 static int zcache_cpu_notifier(struct notifier_block *nb,
 				unsigned long action, void *pcpu)
 {
 	int cpu = (long)pcpu;
 	struct zcache_preload *kp;
+	struct crypto_comp *tfm;
 
 	switch (action) {
 	case CPU_UP_PREPARE:
 		per_cpu(zcache_dstmem, cpu) = (void *)__get_free_pages(
 			GFP_KERNEL | __GFP_REPEAT,
-			LZO_DSTMEM_PAGE_ORDER),
-		per_cpu(zcache_workmem, cpu) =
-			kzalloc(LZO1X_MEM_COMPRESS,
-				GFP_KERNEL | __GFP_REPEAT);
+			ZCACHE_DSTMEM_PAGE_ORDER);
+		/* decompression can't do without a transform */
+		tfm = crypto_alloc_comp(zcache_comp_name, 0, 0);
+		if (IS_ERR(tfm)) {
+			free_pages((unsigned long)per_cpu(zcache_dstmem, cpu),
+					ZCACHE_DSTMEM_PAGE_ORDER);
+			per_cpu(zcache_dstmem, cpu) = NULL;
+			return NOTIFY_BAD;
+		}
+		per_cpu(zcache_comp_tfm, cpu) = tfm;
 		break;
 	case CPU_DEAD:
 	case CPU_UP_CANCELED:
 		free_pages((unsigned long)per_cpu(zcache_dstmem, cpu),
-				LZO_DSTMEM_PAGE_ORDER);
+				ZCACHE_DSTMEM_PAGE_ORDER);
 		per_cpu(zcache_dstmem, cpu) = NULL;
-		kfree(per_cpu(zcache_workmem, cpu));
-		per_cpu(zcache_workmem, cpu) = NULL;
+		if (per_cpu(zcache_comp_tfm, cpu))
+			crypto_free_comp(per_cpu(zcache_comp_tfm, cpu));
+		per_cpu(zcache_comp_tfm, cpu) = NULL;
 		kp = &per_cpu(zcache_preloads, cpu);
 		while (kp->nr) {
 			kmem_cache_free(zcache_objnode_cache,
@@ -1121,6 +1253,8 @@ ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(aborted_preload);
 ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
+ZCACHE_SYSFS_RO(writeback_pages);
+ZCACHE_SYSFS_RO(writeback_failed);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1130,7 +1264,14 @@ ZCACHE_SYSFS_RO_CUSTOM(zbud_unbuddied_list_counts,
 ZCACHE_SYSFS_RO_CUSTOM(zbud_cumul_chunk_counts,
 			zbud_show_cumul_chunk_counts);
 
+static int zcache_compressor_show_buf(char *buf)
+{
+	return sprintf(buf, "%s\n", zcache_comp_name);
+}
+ZCACHE_SYSFS_RO_CUSTOM(compressor, zcache_compressor_show_buf);
+
 static struct attribute *zcache_attrs[] = {
+	&zcache_compressor_attr.attr,
 	&zcache_curr_obj_count_attr.attr,
 	&zcache_curr_obj_count_max_attr.attr,
 	&zcache_curr_objnode_count_attr.attr,
@@ -1142,6 +1283,8 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_eph_puts_attr.attr,
 	&zcache_failed_pers_puts_attr.attr,
 	&zcache_compress_poor_attr.attr,
+	&zcache_writeback_pages_attr.attr,
+	&zcache_writeback_failed_attr.attr,
 	&zcache_zbud_curr_raw_pages_attr.attr,
 	&zcache_zbud_curr_zpages_attr.attr,
 	&zcache_zbud_curr_zbytes_attr.attr,
@@ -1164,10 +1307,88 @@ static struct attribute *zcache_attrs[] = {
 
 static struct attribute_group zcache_attr_group = {
 	.attrs = zcache_attrs,
-	.name = "zcache",
 };
 
+static struct kobject *zcache_kobj;
+
+struct zcache_pool_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct zcache_pool_stats *, char *);
+};
+
+#define ZCACHE_POOL_ATTR(_name, _fmt, _val) \
+	static ssize_t zcache_pool_##_name##_show( \
+				struct zcache_pool_stats *stats, char *buf) \
+	{ \
+		return sprintf(buf, _fmt "\n", _val); \
+	} \
+	static struct zcache_pool_attr zcache_pool_##_name##_attr = { \
+		.attr = { .name = __stringify(_name), .mode = 0444 }, \
+		.show = zcache_pool_##_name##_show, \
+	}
+
+ZCACHE_POOL_ATTR(type, "%s", stats->persistent ? "persistent" : "ephemeral");
+ZCACHE_POOL_ATTR(compressed, "%lu", stats->compressed);
+ZCACHE_POOL_ATTR(compr_bytes, "%lu", stats->compr_bytes);
+ZCACHE_POOL_ATTR(compress_poor, "%lu", stats->compress_poor);
+ZCACHE_POOL_ATTR(compress_ns, "%llu", stats->compress_ns);
+ZCACHE_POOL_ATTR(decompressed, "%lu", stats->decompressed);
+ZCACHE_POOL_ATTR(decompress_ns, "%llu", stats->decompress_ns);
+/* compressed size in percent of the original, 0 if nothing compressed */
+ZCACHE_POOL_ATTR(compr_ratio, "%llu", stats->compressed == 0 ? 0ULL :
+	div64_u64((u64)stats->compr_bytes * 100,
+		  (u64)stats->compressed * PAGE_SIZE));
+
+static ssize_t zcache_pool_zbud_chunk_counts_show(
+			struct zcache_pool_stats *stats, char *buf)
+{
+	return zbud_show_chunk_counts(stats->zbud_chunk_counts, buf);
+}
+static struct zcache_pool_attr zcache_pool_zbud_chunk_counts_attr = {
+	.attr = { .name = "zbud_chunk_counts", .mode = 0444 },
+	.show = zcache_pool_zbud_chunk_counts_show,
+};
+
+static struct attribute *zcache_pool_attrs[] = {
+	&zcache_pool_type_attr.attr,
+	&zcache_pool_compressed_attr.attr,
+	&zcache_pool_compr_bytes_attr.attr,
+	&zcache_pool_compr_ratio_attr.attr,
+	&zcache_pool_compress_poor_attr.attr,
+	&zcache_pool_compress_ns_attr.attr,
+	&zcache_pool_decompressed_attr.attr,
+	&zcache_pool_decompress_ns_attr.attr,
+	&zcache_pool_zbud_chunk_counts_attr.attr,
+	NULL,
+};
+
+static ssize_t zcache_pool_attr_show(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	struct zcache_pool_stats *stats =
+		container_of(kobj, struct zcache_pool_stats, kobj);
+
+	return container_of(attr, struct zcache_pool_attr, attr)->show(stats,
+									buf);
+}
+
+static const struct sysfs_ops zcache_pool_sysfs_ops = {
+	.show = zcache_pool_attr_show,
+};
 #endif /* CONFIG_SYSFS */
+
+static void zcache_pool_stats_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct zcache_pool_stats, kobj));
+}
+
+static struct kobj_type zcache_pool_ktype = {
+	.release = zcache_pool_stats_release,
+#ifdef CONFIG_SYSFS
+	.sysfs_ops = &zcache_pool_sysfs_ops,
+	.default_attrs = zcache_pool_attrs,
+#endif
+};
 /*
  * When zcache is disabled ("frozen"), pools can be created and destroyed,
  * but all puts (and thus all other operations that require memory allocation)
@@ -1316,6 +1537,8 @@ static int zcache_destroy_pool(int pool_id)
 	ret = tmem_destroy_pool(pool);
 	local_bh_enable();
 	kfree(pool);
+	kobject_put(&zcache_pool_stats[pool_id]->kobj);
+	zcache_pool_stats[pool_id] = NULL;
 	pr_info("zcache: destroyed pool id=%d\n", pool_id);
 out:
 	return ret;
@@ -1325,10 +1548,14 @@ static int zcache_new_pool(uint32_t flags)
 {
 	int poolid = -1;
 	struct tmem_pool *pool;
+	struct zcache_pool_stats *stats;
 
 	pool = kmalloc(sizeof(struct tmem_pool), GFP_KERNEL);
-	if (pool == NULL) {
+	stats = kzalloc(sizeof(struct zcache_pool_stats), GFP_KERNEL);
+	if (pool == NULL || stats == NULL) {
 		pr_info("zcache: pool creation failed: out of memory\n");
+		kfree(pool);
+		kfree(stats);
 		goto out;
 	}
 
@@ -1338,6 +1565,7 @@ static int zcache_new_pool(uint32_t flags)
 	if (poolid >= MAX_POOLS_PER_CLIENT) {
 		pr_info("zcache: pool creation failed: max exceeded\n");
 		kfree(pool);
+		kfree(stats);
 		poolid = -1;
 		goto out;
 	}
@@ -1345,6 +1573,14 @@ static int zcache_new_pool(uint32_t flags)
 	pool->client = &zcache_client;
 	pool->pool_id = poolid;
 	tmem_new_pool(pool, flags);
+	stats->persistent = flags & TMEM_POOL_PERSIST;
+	kobject_init(&stats->kobj, &zcache_pool_ktype);
+#ifdef CONFIG_SYSFS
+	if (kobject_add(&stats->kobj, zcache_kobj, "pool%d", poolid))
+		pr_warning("zcache: can't create sysfs for pool %d\n",
+			poolid);
+#endif
+	zcache_pool_stats[poolid] = stats;
 	zcache_client.tmem_pools[poolid] = pool;
 	pr_info("zcache: created %s tmem pool, id=%d\n",
 		flags & TMEM_POOL_PERSIST ? "persistent" : "ephemeral",
@@ -1531,6 +1767,79 @@ static void zcache_frontswap_flush_area(unsigned type)
 	}
 }
 
+/*
+ * Writeback of persistent pages to the swap device, oldest first. Pages
+ * are requested by the shrinker and when the pool is full, and written
+ * by a work item, since it may sleep in allocations and I/O.
+ */
+#define ZCACHE_WB_MAX_PENDING	1024
+
+static atomic_t zcache_writeback_pending = ATOMIC_INIT(0);
+static struct workqueue_struct *zcache_writeback_wq;
+
+static void zcache_frontswap_writeback(struct work_struct *work)
+{
+	struct zv_entry *zve;
+	struct zv_hdr *zv;
+	unsigned type;
+	pgoff_t offset;
+
+	while (atomic_add_unless(&zcache_writeback_pending, -1, 0)) {
+		spin_lock_irq(&zv_lru_lock);
+		if (list_empty(&zv_lru)) {
+			spin_unlock_irq(&zv_lru_lock);
+			atomic_set(&zcache_writeback_pending, 0);
+			break;
+		}
+		zve = list_first_entry(&zv_lru, struct zv_entry, lru);
+		/* don't retry a page that can't be written right away */
+		list_move_tail(&zve->lru, &zv_lru);
+		zv = zs_map_object(zcache_client.zspool, zve->handle);
+		type = zv->oid.oid[0] >> SWIZ_BITS;
+		offset = ((pgoff_t)zv->index << SWIZ_BITS) |
+			(zv->oid.oid[0] & SWIZ_MASK);
+		zs_unmap_object(zcache_client.zspool, zve->handle);
+		spin_unlock_irq(&zv_lru_lock);
+
+		/* flushes the zv from zcache on success */
+		if (frontswap_writeback_page(type, offset))
+			zcache_writeback_failed++;
+		else
+			zcache_writeback_pages++;
+		cond_resched();
+	}
+}
+
+static DECLARE_WORK(zcache_writeback_work, zcache_frontswap_writeback);
+
+static void zcache_frontswap_writeback_kick(int nr)
+{
+	if (zcache_writeback_wq == NULL)
+		return;
+	if (atomic_add_return(nr, &zcache_writeback_pending) >
+						ZCACHE_WB_MAX_PENDING)
+		atomic_set(&zcache_writeback_pending, ZCACHE_WB_MAX_PENDING);
+	queue_work(zcache_writeback_wq, &zcache_writeback_work);
+}
+
+/*
+ * Writing a page back costs a decompression and a disk write now, and a
+ * disk read later, so the shrinker asks for few pages (high seeks) and
+ * only acts under sustained memory pressure.
+ */
+static int shrink_zcache_frontswap(struct shrinker *shrink, int nr,
+					gfp_t gfp_mask)
+{
+	if (nr > 0 && (gfp_mask & __GFP_IO))
+		zcache_frontswap_writeback_kick(nr);
+	return atomic_read(&zcache_curr_pers_pampd_count);
+}
+
+static struct shrinker zcache_frontswap_shrinker = {
+	.shrink = shrink_zcache_frontswap,
+	.seeks = DEFAULT_SEEKS * 4,
+};
+
 static void zcache_frontswap_init(unsigned ignored)
 {
 	/* a single tmem poolid is used for all frontswap "types" (swapfiles) */
@@ -1561,11 +1870,19 @@ struct frontswap_ops zcache_frontswap_register_ops(void)
  * NOTHING HAPPENS!
  */
 
+#ifdef MODULE
+/* loading the module is what enables it */
+static int zcache_enabled = 1;
+#else
 static int zcache_enabled;
+#endif
 
+/* "zcache" enables zcache with lzo, "zcache=<compressor>" picks another */
 static int __init enable_zcache(char *s)
 {
 	zcache_enabled = 1;
+	if (*s++ == '=')
+		strlcpy(zcache_comp_name, s, sizeof(zcache_comp_name));
 	return 1;
 }
 __setup("zcache", enable_zcache);
@@ -1597,7 +1914,13 @@ static int __init zcache_init(void)
 #ifdef CONFIG_SYSFS
 	int ret = 0;
 
-	ret = sysfs_create_group(mm_kobj, &zcache_attr_group);
+	zcache_kobj = kobject_create_and_add("zcache", mm_kobj);
+	if (zcache_kobj == NULL) {
+		pr_err("zcache: can't create sysfs\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+	ret = sysfs_create_group(zcache_kobj, &zcache_attr_group);
 	if (ret) {
 		pr_err("zcache: can't create sysfs\n");
 		goto out;
@@ -1607,6 +1930,12 @@ static int __init zcache_init(void)
 	if (zcache_enabled) {
 		unsigned int cpu;
 
+		if (!crypto_has_comp(zcache_comp_name, 0, 0)) {
+			pr_warning("zcache: compressor %s not available, "
+				"using lzo\n", zcache_comp_name);
+			strcpy(zcache_comp_name, "lzo");
+		}
+		pr_info("zcache: using %s compressor\n", zcache_comp_name);
 		tmem_register_hostops(&zcache_hostops);
 		tmem_register_pamops(&zcache_pamops);
 		ret = register_cpu_notifier(&zcache_cpu_notifier_block);
@@ -1616,14 +1945,21 @@ static int __init zcache_init(void)
 		}
 		for_each_online_cpu(cpu) {
 			void *pcpu = (void *)(long)cpu;
-			zcache_cpu_notifier(&zcache_cpu_notifier_block,
-				CPU_UP_PREPARE, pcpu);
+			if (zcache_cpu_notifier(&zcache_cpu_notifier_block,
+				CPU_UP_PREPARE, pcpu) == NOTIFY_BAD) {
+				pr_err("zcache: can't allocate %s "
+					"compressor\n", zcache_comp_name);
+				ret = -ENOMEM;
+				goto out;
+			}
 		}
 	}
 	zcache_objnode_cache = kmem_cache_create("zcache_objnode",
 				sizeof(struct tmem_objnode), 0, 0, NULL);
 	zcache_obj_cache = kmem_cache_create("zcache_obj",
 				sizeof(struct tmem_obj), 0, 0, NULL);
+	zcache_zv_cache = kmem_cache_create("zcache_zv",
+				sizeof(struct zv_entry), 0, 0, NULL);
 #endif
 #ifdef CONFIG_CLEANCACHE
 	if (zcache_enabled && use_cleancache) {
@@ -1642,14 +1978,20 @@ static int __init zcache_init(void)
 	if (zcache_enabled && use_frontswap) {
 		struct frontswap_ops old_ops;
 
-		zcache_client.xvpool = xv_create_pool();
-		if (zcache_client.xvpool == NULL) {
-			pr_err("zcache: can't create xvpool\n");
+		zcache_client.zspool = zs_create_pool("zcache");
+		if (zcache_client.zspool == NULL) {
+			pr_err("zcache: can't create zspool\n");
 			goto out;
 		}
+		zcache_writeback_wq = create_singlethread_workqueue("zcache_wb");
+		if (zcache_writeback_wq == NULL)
+			pr_warning("zcache: can't create writeback workqueue, "
+				"frontswap pages won't be written back\n");
+		else
+			register_shrinker(&zcache_frontswap_shrinker);
 		old_ops = zcache_frontswap_register_ops();
 		pr_info("zcache: frontswap enabled using kernel "
-			"transcendent memory and xvmalloc\n");
+			"transcendent memory and zsmalloc\n");
 		if (old_ops.init != NULL)
 			pr_warning("ktmem: frontswap_ops overridden");
 	}
@@ -1659,3 +2001,4 @@ out:
 }
 
 module_init(zcache_init)
+MODULE_LICENSE("GPL");
@@ -0,0 +1,237 @@
+/*
+ * Compressed RAM block device: compression streams
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/cpu.h>
+#include <linux/crypto.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zcomp.h"
+
+/*
+ * Compression backends selectable through the 'comp_algorithm' sysfs
+ * node, and the crypto API compression algorithm backing each of them.
+ */
+static const struct zcomp_backend {
+	const char *name;
+	const char *crypto_name;
+} backends[] = {
+	{ "lzo",	"lzo" },
+	{ "lz4",	"lz4" },
+	{ "snappy",	"snappy" },
+	{ "zlib",	"deflate" },
+	{ "none",	"compress_null" },
+};
+
+static const struct zcomp_backend *find_backend(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		if (sysfs_streq(name, backends[i].name))
+			return &backends[i];
+	}
+
+	return NULL;
+}
+
+static void zcomp_strm_free(struct zcomp_strm *zstrm)
+{
+	if (!zstrm)
+		return;
+
+	if (zstrm->tfm)
+		crypto_free_comp(zstrm->tfm);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	zstrm = kzalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->tfm = crypto_alloc_comp(comp->backend->crypto_name, 0, 0);
+	if (IS_ERR(zstrm->tfm))
+		zstrm->tfm = NULL;
+	/*
+	 * Allocate 2 pages: 1 for compressed data, plus 1 extra for the
+	 * case when compressed size is larger than the original one.
+	 */
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!zstrm->tfm || !zstrm->buffer) {
+		zcomp_strm_free(zstrm);
+		zstrm = NULL;
+	}
+
+	return zstrm;
+}
+
+static int zcomp_cpu_notifier(struct notifier_block *nb,
+				unsigned long action, void *pcpu)
+{
+	int cpu = (long)pcpu;
+	struct zcomp *comp = container_of(nb, struct zcomp, notifier);
+	struct zcomp_strm **pstrm = per_cpu_ptr(comp->stream, cpu);
+
+	switch (action) {
+	case CPU_UP_PREPARE:
+		if (*pstrm)
+			break;
+		*pstrm = zcomp_strm_alloc(comp);
+		if (!*pstrm) {
+			pr_err("Can't allocate compression stream "
+				"for cpu %d\n", cpu);
+			return notifier_from_errno(-ENOMEM);
+		}
+		break;
+	case CPU_DEAD:
+	case CPU_UP_CANCELED:
+		zcomp_strm_free(*pstrm);
+		*pstrm = NULL;
+		break;
+	default:
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
+{
+	return *per_cpu_ptr(comp->stream, get_cpu());
+}
+
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	put_cpu();
+}
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len)
+{
+	int ret;
+	unsigned int dlen = 2 * PAGE_SIZE;
+
+	ret = crypto_comp_compress(zstrm->tfm, src, PAGE_SIZE,
+				zstrm->buffer, &dlen);
+	*dst_len = dlen;
+
+	return ret;
+}
+
+int zcomp_decompress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t src_len, unsigned char *dst)
+{
+	unsigned int dlen = PAGE_SIZE;
+
+	return crypto_comp_decompress(zstrm->tfm, src, src_len, dst, &dlen);
+}
+
+/* Show available backends, with the selected one in brackets */
+ssize_t zcomp_available_show(const char *comp, char *buf)
+{
+	int i;
+	ssize_t sz = 0;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		if (!crypto_has_comp(backends[i].crypto_name, 0, 0))
+			continue;
+		if (!strcmp(comp, backends[i].name))
+			sz += sprintf(buf + sz, "[%s] ", backends[i].name);
+		else
+			sz += sprintf(buf + sz, "%s ", backends[i].name);
+	}
+	if (sz)
+		buf[sz - 1] = '\n';
+
+	return sz;
+}
+
+/*
+ * Return the canonical name of backend 'comp', or NULL if it is unknown
+ * or its crypto algorithm is not available in this kernel.
+ */
+const char *zcomp_available_algorithm(const char *comp)
+{
+	const struct zcomp_backend *backend = find_backend(comp);
+
+	if (!backend || !crypto_has_comp(backend->crypto_name, 0, 0))
+		return NULL;
+
+	return backend->name;
+}
+
+void zcomp_destroy(struct zcomp *comp)
+{
+	int cpu;
+
+	unregister_cpu_notifier(&comp->notifier);
+	for_each_possible_cpu(cpu) {
+		zcomp_strm_free(*per_cpu_ptr(comp->stream, cpu));
+		*per_cpu_ptr(comp->stream, cpu) = NULL;
+	}
+	free_percpu(comp->stream);
+	kfree(comp);
+}
+
+struct zcomp *zcomp_create(const char *compress)
+{
+	int cpu, ret;
+	struct zcomp *comp;
+	const struct zcomp_backend *backend;
+
+	backend = find_backend(compress);
+	if (!backend)
+		return NULL;
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return NULL;
+
+	comp->backend = backend;
+
+	comp->stream = alloc_percpu(struct zcomp_strm *);
+	if (!comp->stream) {
+		kfree(comp);
+		return NULL;
+	}
+
+	comp->notifier.notifier_call = zcomp_cpu_notifier;
+	ret = register_cpu_notifier(&comp->notifier);
+	if (ret) {
+		free_percpu(comp->stream);
+		kfree(comp);
+		return NULL;
+	}
+
+	for_each_online_cpu(cpu) {
+		ret = zcomp_cpu_notifier(&comp->notifier, CPU_UP_PREPARE,
+					(void *)(long)cpu);
+		if (notifier_to_errno(ret)) {
+			zcomp_destroy(comp);
+			return NULL;
+		}
+	}
+
+	return comp;
+}
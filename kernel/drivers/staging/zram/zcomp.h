@@ -0,0 +1,63 @@
+/*
+ * Compressed RAM block device: compression streams
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/notifier.h>
+#include <linux/percpu.h>
+
+struct crypto_comp;
+struct zcomp_backend;
+
+/*
+ * A compression stream holds everything needed to (de)compress one page:
+ * a crypto API compressor instance, which carries its own working memory,
+ * and a (2 * PAGE_SIZE) output buffer, big enough for the worst case
+ * expansion of an incompressible page.
+ */
+struct zcomp_strm {
+	void *buffer;
+	struct crypto_comp *tfm;
+};
+
+/*
+ * Each online CPU owns one stream, so concurrent writers compress in
+ * parallel instead of serializing on a single per-device buffer.
+ */
+struct zcomp {
+	struct zcomp_strm * __percpu *stream;
+	struct notifier_block notifier;
+	const struct zcomp_backend *backend;
+};
+
+ssize_t zcomp_available_show(const char *comp, char *buf);
+const char *zcomp_available_algorithm(const char *comp);
+
+struct zcomp *zcomp_create(const char *comp);
+void zcomp_destroy(struct zcomp *comp);
+
+/*
+ * zcomp_strm_find() returns the current CPU's stream with preemption
+ * disabled; the caller must not sleep until zcomp_strm_release().
+ */
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+int zcomp_decompress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t src_len, unsigned char *dst);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Compressed RAM block device: same page deduplication
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* One hash bucket per this many disk pages */
+#define ZRAM_HASH_SHIFT		4
+#define ZRAM_HASH_SEED		0x5a3d7e91
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash2((const u32 *)mem, PAGE_SIZE / sizeof(u32),
+			ZRAM_HASH_SEED);
+}
+
+static struct zram_hash *zram_hash_bucket(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum % zram->hash_size];
+}
+
+/*
+ * Look up an entry with the given checksum and take a reference on it.
+ * Equal checksums do not guarantee equal pages: the caller has to check
+ * the contents and drop the reference with zram_dedup_put() on mismatch.
+ */
+struct zram_entry *zram_dedup_get(struct zram *zram, u32 checksum)
+{
+	struct zram_hash *hash = zram_hash_bucket(zram, checksum);
+	struct rb_node *rb_node;
+	struct zram_entry *entry;
+
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum) {
+			entry->refcount++;
+			spin_unlock(&hash->lock);
+			return entry;
+		}
+
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+	spin_unlock(&hash->lock);
+
+	return NULL;
+}
+
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new)
+{
+	struct zram_hash *hash = zram_hash_bucket(zram, new->checksum);
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		if (new->checksum < entry->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+
+	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_insert_color(&new->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+}
+
+/*
+ * Drop a reference. Returns the number of references left; once it
+ * reaches zero the entry is unhashed and the caller must free it.
+ */
+unsigned long zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_hash_bucket(zram, entry->checksum);
+	unsigned long refcount;
+
+	spin_lock(&hash->lock);
+	refcount = --entry->refcount;
+	if (!refcount)
+		rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	return refcount;
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	zram->hash_size = max_t(size_t, num_pages >> ZRAM_HASH_SHIFT, 1);
+	zram->hash = vzalloc(zram->hash_size * sizeof(struct zram_hash));
+	if (!zram->hash)
+		return -ENOMEM;
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Compressed RAM block device: same page deduplication
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Project home: http://compcache.googlecode.com
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+
+struct zram;
+
+/*
+ * With deduplication enabled, table entries point to one of these
+ * instead of directly to a zsmalloc object. Pages with identical
+ * contents share a single entry; the object is freed when the last
+ * table entry referencing it goes away.
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	u16 len;
+	unsigned long refcount;
+	void *handle;
+};
+
+/* Entries are hashed by checksum into buckets of rb-trees */
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_entry *zram_dedup_get(struct zram *zram, u32 checksum);
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new);
+unsigned long zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+#else
+static inline u32 zram_dedup_checksum(unsigned char *mem) { return 0; }
+static inline struct zram_entry *zram_dedup_get(struct zram *zram,
+				u32 checksum) { return NULL; }
+static inline void zram_dedup_insert(struct zram *zram,
+				struct zram_entry *new) { }
+static inline unsigned long zram_dedup_put(struct zram *zram,
+				struct zram_entry *entry) { return 0; }
+
+static inline int zram_dedup_init(struct zram *zram,
+				size_t num_pages) { return 0; }
+static inline void zram_dedup_fini(struct zram *zram) { }
+#endif
+
+#endif
@@ -25,75 +25,47 @@
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
+#include <linux/bit_spinlock.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
+#include <linux/fs.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
-#if defined(CONFIG_ZRAM_LZO)
-#include <linux/lzo.h>
-#define WMSIZE		LZO1X_MEM_COMPRESS
-#define COMPRESS(s, sl, d, dl, wm)	\
-	lzo1x_1_compress(s, sl, d, dl, wm)
-#define DECOMPRESS(s, sl, d, dl)	\
-	lzo1x_decompress_safe(s, sl, d, dl)
-#elif defined(CONFIG_ZRAM_SNAPPY)
-#include "../snappy/csnappy.h" /* if built in drivers/staging */
-#define WMSIZE_ORDER	((PAGE_SHIFT > 14) ? (15) : (PAGE_SHIFT+1))
-#define WMSIZE		(1 << WMSIZE_ORDER)
-static int
-snappy_compress_(
-	const unsigned char *src,
-	size_t src_len,
-	unsigned char *dst,
-	size_t *dst_len,
-	void *workmem)
-{
-	const unsigned char *end = csnappy_compress_fragment(
-		src, (uint32_t)src_len, dst, workmem, WMSIZE_ORDER);
-	*dst_len = end - dst;
-	return 0;
-}
-static int
-snappy_decompress_(
-	const unsigned char *src,
-	size_t src_len,
-	unsigned char *dst,
-	size_t *dst_len)
-{
-	uint32_t dst_len_ = (uint32_t)*dst_len;
-	int ret = csnappy_decompress_noheader(src, src_len, dst, &dst_len_);
-	*dst_len = (size_t)dst_len_;
-	return ret;
-}
-#define COMPRESS(s, sl, d, dl, wm)	\
-	snappy_compress_(s, sl, d, dl, wm)
-#define DECOMPRESS(s, sl, d, dl)	\
-	snappy_decompress_(s, sl, d, dl)
-#else
-#error either CONFIG_ZRAM_LZO or CONFIG_ZRAM_SNAPPY must be defined
-#endif
-
-
 /* Globals */
 static int zram_major;
 struct zram *zram_devices;
+static struct workqueue_struct *zram_read_wq;
+
+#if defined(CONFIG_ZRAM_SNAPPY)
+static const char *default_compressor = "snappy";
+#elif defined(CONFIG_ZRAM_LZ4)
+static const char *default_compressor = "lz4";
+#else
+static const char *default_compressor = "lzo";
+#endif
 
 /* Module params (documentation at end) */
 unsigned int zram_num_devices;
 
-static void zram_stat_inc(u32 *v)
+static void zram_stat_inc(atomic_t *v)
 {
-	*v = *v + 1;
+	atomic_inc(v);
 }
 
-static void zram_stat_dec(u32 *v)
+static void zram_stat_dec(atomic_t *v)
 {
-	*v = *v - 1;
+	atomic_dec(v);
 }
 
 static void zram_stat64_add(struct zram *zram, u64 *v, u64 inc)
@@ -115,39 +87,204 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+#ifdef CONFIG_ZRAM_LOCK_STAT
+static struct dentry *zram_debugfs_root;
+
+static void zram_lock_stat_add(u64 *hist, u64 ns)
+{
+	int bucket = ns ? min_t(int, ilog2(ns), ZRAM_LOCK_STAT_BUCKETS - 1) : 0;
+
+	hist[bucket]++;
+}
+
+/* Preemption is disabled while a slot lock is held */
+static void zram_lock_stat_acquired(struct zram *zram, u64 start)
+{
+	struct zram_lock_stat *stat;
+
+	stat = per_cpu_ptr(zram->lock_stat, smp_processor_id());
+	stat->acquired = sched_clock();
+	zram_lock_stat_add(stat->wait, stat->acquired - start);
+}
+
+static void zram_lock_stat_released(struct zram *zram)
+{
+	struct zram_lock_stat *stat;
+
+	stat = per_cpu_ptr(zram->lock_stat, smp_processor_id());
+	zram_lock_stat_add(stat->hold, sched_clock() - stat->acquired);
+}
+
+static int zram_lock_stat_show(struct seq_file *m, void *v)
+{
+	int i, cpu;
+	u64 wait, hold;
+	struct zram *zram = m->private;
+	struct zram_lock_stat *stat;
+
+	seq_printf(m, "%12s %12s %12s\n", "ns", "wait", "hold");
+	for (i = 0; i < ZRAM_LOCK_STAT_BUCKETS; i++) {
+		wait = hold = 0;
+		for_each_possible_cpu(cpu) {
+			stat = per_cpu_ptr(zram->lock_stat, cpu);
+			wait += stat->wait[i];
+			hold += stat->hold[i];
+		}
+		seq_printf(m, "%12llu %12llu %12llu\n", 1ULL << i, wait, hold);
+	}
+
+	return 0;
+}
+
+static int zram_lock_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zram_lock_stat_show, inode->i_private);
+}
+
+static const struct file_operations zram_lock_stat_fops = {
+	.open		= zram_lock_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int zram_lock_stat_init(struct zram *zram)
+{
+	zram->lock_stat = alloc_percpu(struct zram_lock_stat);
+	if (!zram->lock_stat)
+		return -ENOMEM;
+
+	if (zram_debugfs_root)
+		zram->debugfs_file = debugfs_create_file(
+				zram->disk->disk_name, S_IRUGO,
+				zram_debugfs_root, zram,
+				&zram_lock_stat_fops);
+
+	return 0;
+}
+
+static void zram_lock_stat_fini(struct zram *zram)
+{
+	debugfs_remove(zram->debugfs_file);
+	zram->debugfs_file = NULL;
+	free_percpu(zram->lock_stat);
+	zram->lock_stat = NULL;
+}
+
+static void zram_debugfs_create(void)
+{
+	zram_debugfs_root = debugfs_create_dir("zram", NULL);
+	if (IS_ERR(zram_debugfs_root))
+		zram_debugfs_root = NULL;
+}
+
+static void zram_debugfs_destroy(void)
+{
+	debugfs_remove(zram_debugfs_root);
+	zram_debugfs_root = NULL;
+}
+#else
+static inline void zram_lock_stat_acquired(struct zram *zram, u64 start) { }
+static inline void zram_lock_stat_released(struct zram *zram) { }
+static inline int zram_lock_stat_init(struct zram *zram) { return 0; }
+static inline void zram_lock_stat_fini(struct zram *zram) { }
+static inline void zram_debugfs_create(void) { }
+static inline void zram_debugfs_destroy(void) { }
+#endif
+
+/*
+ * Each table entry has its own lock, a bit spinlock in its 'value'
+ * word, so that reads, writes and frees of different pages never
+ * contend. Nothing may sleep while it is held.
+ */
+static void zram_slot_lock(struct zram *zram, u32 index)
+{
+	u64 start = 0;
+
+#ifdef CONFIG_ZRAM_LOCK_STAT
+	start = sched_clock();
+#endif
+	bit_spin_lock(ZRAM_LOCK, &zram->table[index].value);
+	zram_lock_stat_acquired(zram, start);
+}
+
+static void zram_slot_unlock(struct zram *zram, u32 index)
+{
+	zram_lock_stat_released(zram);
+	bit_spin_unlock(ZRAM_LOCK, &zram->table[index].value);
+}
+
+/* Flag and size accessors; the slot must be locked */
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	return zram->table[index].flags & BIT(flag);
+	return zram->table[index].value & BIT(flag);
 }
 
 static void zram_set_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	zram->table[index].flags |= BIT(flag);
+	zram->table[index].value |= BIT(flag);
 }
 
 static void zram_clear_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	zram->table[index].flags &= ~BIT(flag);
+	zram->table[index].value &= ~BIT(flag);
+}
+
+static size_t zram_get_obj_size(struct zram *zram, u32 index)
+{
+	return zram->table[index].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
+}
+
+static void zram_set_obj_size(struct zram *zram, u32 index, size_t size)
+{
+	unsigned long flags = zram->table[index].value >> ZRAM_FLAG_SHIFT;
+
+	zram->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check whether the page is filled with a single repeated word, and
+ * return that word in *element if it is.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
+
 	return 1;
 }
 
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned int pos;
+	unsigned long *page;
+
+	/*
+	 * A word made of a single repeated byte (zero being the most
+	 * common case) is handled by the optimized arch memset().
+	 */
+	if (value == (value & 0xff) * (~0UL / 0xff)) {
+		memset(ptr, value & 0xff, len);
+		return;
+	}
+
+	page = (unsigned long *)ptr;
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
 static u64 zram_default_disksize_bytes(void)
 {
 #if 0
@@ -163,57 +300,238 @@ static void zram_set_disksize(struct zram *zram, u64 size_bytes)
 	set_capacity(zram->disk, size_bytes >> SECTOR_SHIFT);
 }
 
+/* zsmalloc handle of the object stored for the given page, if any */
+static void *zram_get_handle(struct zram *zram, u32 index)
+{
+	if (zram_dedup_enabled(zram) && zram->table[index].entry)
+		return zram->table[index].entry->handle;
+
+	return zram->table[index].handle;
+}
+
+static void zram_entry_free(struct zram *zram, struct zram_entry *entry)
+{
+	zs_free(zram->mem_pool, entry->handle);
+	zram_stat64_sub(zram, &zram->stats.compr_size, entry->len);
+	kfree(entry);
+}
+
+static void zram_entry_put(struct zram *zram, struct zram_entry *entry)
+{
+	u16 len = entry->len;
+
+	if (zram_dedup_put(zram, entry)) {
+		/* Object is still used by other pages */
+		zram_stat64_sub(zram, &zram->stats.pages_deduped, 1);
+		zram_stat64_sub(zram, &zram->stats.dedup_bytes_saved, len);
+		return;
+	}
+
+	zram_entry_free(zram, entry);
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Max. number of pages written to the backing device at once */
+#define ZRAM_WB_BATCH		32
+
+static unsigned long zram_bd_alloc_blk(struct zram *zram)
+{
+	unsigned long blk;
+
+	spin_lock(&zram->bitmap_lock);
+	/* Block 0 is skipped, so that 0 can mean failure */
+	blk = find_next_zero_bit(zram->bitmap, zram->nr_pages, 1);
+	if (blk >= zram->nr_pages)
+		blk = 0;
+	else
+		__set_bit(blk, zram->bitmap);
+	spin_unlock(&zram->bitmap_lock);
+
+	return blk;
+}
+
+static void zram_bd_free_blk(struct zram *zram, unsigned long blk)
+{
+	spin_lock(&zram->bitmap_lock);
+	WARN_ON_ONCE(!test_bit(blk, zram->bitmap));
+	__clear_bit(blk, zram->bitmap);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+/* Set of bios waited for together */
+struct zram_bd_batch {
+	atomic_t pending;
+	int error;
+	struct completion done;
+};
+
+static void zram_bd_batch_init(struct zram_bd_batch *batch)
+{
+	/* Bias, dropped by zram_bd_batch_wait() */
+	atomic_set(&batch->pending, 1);
+	batch->error = 0;
+	init_completion(&batch->done);
+}
+
+static int zram_bd_batch_wait(struct zram_bd_batch *batch)
+{
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+
+	return batch->error;
+}
+
+static void zram_bd_end_io(struct bio *bio, int err)
+{
+	struct zram_bd_batch *batch = bio->bi_private;
+
+	if (err)
+		batch->error = err;
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static struct bio *zram_bd_bio_alloc(struct zram *zram, unsigned long blk,
+				     int nr_pages, struct zram_bd_batch *batch)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_NOIO, nr_pages);
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bd_end_io;
+	bio->bi_private = batch;
+	atomic_inc(&batch->pending);
+
+	return bio;
+}
+
+struct zram_bd_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int ret;
+};
+
+static void zram_bd_read_work_fn(struct work_struct *work)
+{
+	struct zram_bd_read_work *rw =
+		container_of(work, struct zram_bd_read_work, work);
+	struct zram_bd_batch batch;
+	struct bio *bio;
+
+	zram_bd_batch_init(&batch);
+	bio = zram_bd_bio_alloc(rw->zram, rw->blk, 1, &batch);
+	bio_add_page(bio, rw->page, PAGE_SIZE, 0);
+	submit_bio(READ, bio);
+	rw->ret = zram_bd_batch_wait(&batch);
+}
+
+/*
+ * Read one page back from the backing device. We are called from
+ * zram_make_request(), and generic_make_request() would only dispatch
+ * a bio submitted from here after we return. So the read is issued
+ * and waited for by a worker instead.
+ */
+static int zram_bd_read(struct zram *zram, struct page *page,
+			unsigned long blk)
+{
+	struct zram_bd_read_work rw;
+
+	rw.zram = zram;
+	rw.page = page;
+	rw.blk = blk;
+	INIT_WORK_ON_STACK(&rw.work, zram_bd_read_work_fn);
+	queue_work(zram->bd_wq, &rw.work);
+	flush_work(&rw.work);
+	destroy_work_on_stack(&rw.work);
+
+	if (rw.ret) {
+		pr_err("Read from backing device failed! err=%d, blk=%lu\n",
+			rw.ret, blk);
+		return rw.ret;
+	}
+
+	zram_stat64_inc(zram, &zram->stats.bd_reads);
+	return 0;
+}
+#else
+static inline void zram_bd_free_blk(struct zram *zram, unsigned long blk) { }
+static inline int zram_bd_read(struct zram *zram, struct page *page,
+			unsigned long blk) { return -EIO; }
+#endif
+
+/* Called with the slot locked */
 static void zram_free_page(struct zram *zram, size_t index)
 {
-	u32 clen;
-	void *obj;
+	void *handle = zram->table[index].handle;
+	size_t clen = zram_get_obj_size(zram, index);
 
-	struct page *page = zram->table[index].page;
-	u32 offset = zram->table[index].offset;
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 
-	if (unlikely(!page)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-			zram_clear_flag(zram, index, ZRAM_ZERO);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_bd_free_blk(zram, zram->table[index].element);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_stat64_sub(zram, &zram->stats.bd_count, 1);
+		zram->table[index].element = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		if (!zram->table[index].element)
 			zram_stat_dec(&zram->stats.pages_zero);
-		}
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram_stat_dec(&zram->stats.pages_same);
+		zram->table[index].element = 0;
+		return;
+	}
+
+	if (unlikely(!handle))
 		return;
+
+	if (zram_dedup_enabled(zram)) {
+		zram_entry_put(zram, zram->table[index].entry);
+	} else {
+		zs_free(zram->mem_pool, handle);
+		zram_stat64_sub(zram, &zram->stats.compr_size, clen);
 	}
 
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		clen = PAGE_SIZE;
-		__free_page(page);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
 		zram_stat_dec(&zram->stats.pages_expand);
-		goto out;
-	}
-
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
-
-	xv_free(zram->mem_pool, page, offset);
-	if (clen <= PAGE_SIZE / 2)
+	} else if (clen <= PAGE_SIZE / 2) {
 		zram_stat_dec(&zram->stats.good_compress);
+	}
 
-out:
-	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
 	zram_stat_dec(&zram->stats.pages_stored);
 
-	zram->table[index].page = NULL;
-	zram->table[index].offset = 0;
+	zram->table[index].handle = NULL;
+	zram_set_obj_size(zram, index, 0);
+}
+
+/* Whether anything is stored for the given page */
+static int zram_allocated(struct zram *zram, u32 index)
+{
+	return zram->table[index].handle ||
+		zram_test_flag(zram, index, ZRAM_SAME) ||
+		zram_test_flag(zram, index, ZRAM_WB);
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	flush_dcache_page(page);
@@ -224,12 +542,13 @@ static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
 {
 	struct page *page = bvec->bv_page;
 	unsigned char *user_mem, *cmem;
+	void *handle = zram_get_handle(zram, index);
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1);
+	cmem = zs_map_object(zram->mem_pool, handle);
 
 	memcpy(user_mem + bvec->bv_offset, cmem + offset, bvec->bv_len);
-	kunmap_atomic(cmem, KM_USER1);
+	zs_unmap_object(zram->mem_pool, handle);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	flush_dcache_page(page);
@@ -240,106 +559,172 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+/* Page was written to the backing device: read it back */
+static int handle_bd_page(struct zram *zram, struct bio_vec *bvec,
+			  unsigned long blk, int offset)
+{
+	int ret;
+	struct page *page = bvec->bv_page, *bd_page = page;
+	unsigned char *user_mem, *bd_mem;
+
+	if (is_partial_io(bvec)) {
+		bd_page = alloc_page(GFP_NOIO);
+		if (!bd_page) {
+			pr_info("Error allocating temp memory!\n");
+			return -ENOMEM;
+		}
+	}
+
+	ret = zram_bd_read(zram, bd_page, blk);
+	if (ret) {
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+		goto out;
+	}
+
+	if (is_partial_io(bvec)) {
+		user_mem = kmap_atomic(page, KM_USER0);
+		bd_mem = kmap_atomic(bd_page, KM_USER1);
+		memcpy(user_mem + bvec->bv_offset, bd_mem + offset,
+		       bvec->bv_len);
+		kunmap_atomic(bd_mem, KM_USER1);
+		kunmap_atomic(user_mem, KM_USER0);
+	}
+
+	flush_dcache_page(page);
+out:
+	if (bd_page != page)
+		__free_page(bd_page);
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
+	void *handle;
+	unsigned long element;
 	struct page *page;
-	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
-		return 0;
+	if (is_partial_io(bvec)) {
+		/* Use  a temporary buffer to decompress the page */
+		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (!uncmem) {
+			pr_info("Error allocating temp memory!\n");
+			return -ENOMEM;
+		}
+	}
+
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		element = zram->table[index].element;
+		zram_slot_unlock(zram, index);
+		handle_same_page(bvec, element);
+		ret = 0;
+		goto out;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		element = zram->table[index].element;
+		zram_slot_unlock(zram, index);
+		ret = handle_bd_page(zram, bvec, element, offset);
+		goto out;
 	}
 
 	/* Requested page is not present in compressed area */
-	if (unlikely(!zram->table[index].page)) {
+	if (unlikely(!zram->table[index].handle)) {
+		zram_slot_unlock(zram, index);
 		pr_debug("Read before write: sector=%lu, size=%u",
 			 (ulong)(bio->bi_sector), bio->bi_size);
-		handle_zero_page(bvec);
-		return 0;
+		handle_same_page(bvec, 0);
+		ret = 0;
+		goto out;
 	}
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		handle_uncompressed_page(zram, bvec, index, offset);
-		return 0;
-	}
-
-	if (is_partial_io(bvec)) {
-		/* Use  a temporary buffer to decompress the page */
-		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
-		if (!uncmem) {
-			pr_info("Error allocating temp memory!\n");
-			return -ENOMEM;
-		}
+		zram_slot_unlock(zram, index);
+		ret = 0;
+		goto out;
 	}
 
 	user_mem = kmap_atomic(page, KM_USER0);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
+	handle = zram_get_handle(zram, index);
+	cmem = zs_map_object(zram->mem_pool, handle);
 
-	ret = DECOMPRESS(
-			cmem + sizeof(*zheader),
-			xv_get_object_size(cmem) - sizeof(*zheader),
-			uncmem, &clen);
+	zstrm = zcomp_strm_find(zram->comp);
+	ret = zcomp_decompress(zram->comp, zstrm, cmem,
+			zram_get_obj_size(zram, index), uncmem);
+	zcomp_strm_release(zram->comp, zstrm);
 
-	if (is_partial_io(bvec)) {
+	if (is_partial_io(bvec))
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
 		       bvec->bv_len);
-		kfree(uncmem);
-	}
 
-	kunmap_atomic(cmem, KM_USER1);
+	zs_unmap_object(zram->mem_pool, handle);
 	kunmap_atomic(user_mem, KM_USER0);
+	zram_slot_unlock(zram, index);
 
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
-		return ret;
+		goto out;
 	}
 
 	flush_dcache_page(page);
 
-	return 0;
+out:
+	if (is_partial_io(bvec))
+		kfree(uncmem);
+	return ret;
 }
 
-static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
+/*
+ * Copy the page stored in memory for 'index' to 'mem'. Called with the
+ * slot locked, for any page not written to the backing device.
+ */
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
-	struct zobj_header *zheader;
+	struct zcomp_strm *zstrm;
 	unsigned char *cmem;
+	void *handle;
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, zram->table[index].element);
+		return 0;
+	}
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].page) {
+	handle = zram_get_handle(zram, index);
+	if (!handle) {
 		memset(mem, 0, PAGE_SIZE);
 		return 0;
 	}
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER0) +
-		zram->table[index].offset;
+	cmem = zs_map_object(zram->mem_pool, handle);
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		memcpy(mem, cmem, PAGE_SIZE);
-		kunmap_atomic(cmem, KM_USER0);
+		zs_unmap_object(zram->mem_pool, handle);
 		return 0;
 	}
 
-	ret = DECOMPRESS(cmem + sizeof(*zheader),
-			xv_get_object_size(cmem) - sizeof(*zheader),
-			mem, &clen);
-	kunmap_atomic(cmem, KM_USER0);
+	zstrm = zcomp_strm_find(zram->comp);
+	ret = zcomp_decompress(zram->comp, zstrm, cmem,
+			zram_get_obj_size(zram, index), mem);
+	zcomp_strm_release(zram->comp, zstrm);
+	zs_unmap_object(zram->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret)) {
@@ -351,18 +736,101 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
+{
+	int ret;
+	unsigned long blk;
+	struct page *bd_page;
+	unsigned char *bd_mem;
+
+	zram_slot_lock(zram, index);
+	if (!zram_test_flag(zram, index, ZRAM_WB)) {
+		ret = zram_decompress_page(zram, mem, index);
+		zram_slot_unlock(zram, index);
+		return ret;
+	}
+
+	/* Reading from the backing device sleeps */
+	blk = zram->table[index].element;
+	zram_slot_unlock(zram, index);
+
+	bd_page = alloc_page(GFP_NOIO);
+	if (!bd_page)
+		return -ENOMEM;
+
+	ret = zram_bd_read(zram, bd_page, blk);
+	if (!ret) {
+		bd_mem = kmap_atomic(bd_page, KM_USER1);
+		memcpy(mem, bd_mem, PAGE_SIZE);
+		kunmap_atomic(bd_mem, KM_USER1);
+	}
+	__free_page(bd_page);
+
+	return ret;
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+			     unsigned char *mem)
+{
+	bool match = false;
+	unsigned char *cmem;
+	struct zcomp_strm *zstrm;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle);
+	if (entry->len == PAGE_SIZE) {
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_strm_find(zram->comp);
+		if (!zcomp_decompress(zram->comp, zstrm, cmem, entry->len,
+				      zstrm->buffer))
+			match = !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+		zcomp_strm_release(zram->comp, zstrm);
+	}
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Return an already stored object with the same contents as 'mem',
+ * with a reference taken on it, or NULL if there is none.
+ */
+static struct zram_entry *zram_dedup_find(struct zram *zram,
+					  unsigned char *mem, u32 checksum)
+{
+	struct zram_entry *entry;
+
+	entry = zram_dedup_get(zram, checksum);
+	if (!entry)
+		return NULL;
+
+	if (zram_dedup_match(zram, entry, mem)) {
+		zram_stat64_inc(zram, &zram->stats.pages_deduped);
+		zram_stat64_add(zram, &zram->stats.dedup_bytes_saved,
+				entry->len);
+		return entry;
+	}
+
+	/* Checksum collision: nothing was saved, drop the reference only */
+	if (!zram_dedup_put(zram, entry))
+		zram_entry_free(zram, entry);
+	return NULL;
+}
+
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
-	int ret;
-	u32 store_offset;
-	size_t clen;
-	struct zobj_header *zheader;
-	struct page *page, *page_store;
+	int ret = 0;
+	u32 checksum = 0;
+	unsigned long element;
+	size_t clen, alloc_len = 0;
+	void *handle = NULL, *stored;
+	struct zram_entry *entry = NULL, *found;
+	struct zcomp_strm *zstrm;
+	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -376,20 +844,20 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 		ret = zram_read_before_write(zram, uncmem, index);
-		if (ret) {
-			kfree(uncmem);
-			goto out;
-		}
+		if (ret)
+			goto out_free;
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].page ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
+	if (zram_dedup_enabled(zram)) {
+		entry = kmalloc(sizeof(*entry), GFP_NOIO);
+		if (!entry) {
+			pr_info("Error allocating dedup entry!\n");
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
 
+compress_again:
 	user_mem = kmap_atomic(page, KM_USER0);
 
 	if (is_partial_io(bvec))
@@ -398,28 +866,43 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem, KM_USER0);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
-		ret = 0;
-		goto out;
+		zram_slot_lock(zram, index);
+		zram_free_page(zram, index);
+		zram_set_flag(zram, index, ZRAM_SAME);
+		zram->table[index].element = element;
+		zram_stat_inc(&zram->stats.pages_same);
+		if (!element)
+			zram_stat_inc(&zram->stats.pages_zero);
+		zram_slot_unlock(zram, index);
+		goto out_free;
 	}
 
-	COMPRESS(uncmem, PAGE_SIZE, src, &clen,
-		zram->compress_workmem);
-	ret = 0;
-
-	kunmap_atomic(user_mem, KM_USER0);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
+	if (zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(uncmem);
+		found = zram_dedup_find(zram, uncmem, checksum);
+		if (found) {
+			kunmap_atomic(user_mem, KM_USER0);
+			clen = found->len;
+			stored = found;
+			goto store;
+		}
+	}
 
-	if (unlikely(ret != 0)) {
+	/*
+	 * Compression runs on this CPU's own stream and without the
+	 * slot lock, so writers on other CPUs are not held up by it.
+	 */
+	zstrm = zcomp_strm_find(zram->comp);
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
+	if (unlikely(ret)) {
+		zcomp_strm_release(zram->comp, zstrm);
+		kunmap_atomic(user_mem, KM_USER0);
 		pr_err("Compression failed! err=%d\n", ret);
-		goto out;
+		goto out_free;
 	}
+	src = zstrm->buffer;
 
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
@@ -428,79 +911,340 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	 */
 	if (unlikely(clen > max_zpage_size)) {
 		clen = PAGE_SIZE;
-		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
-		if (unlikely(!page_store)) {
-			pr_info("Error allocating memory for "
-				"incompressible page: %u\n", index);
-			ret = -ENOMEM;
-			goto out;
-		}
+		src = uncmem;
+	}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
-		zram->table[index].page = page_store;
-		src = kmap_atomic(page, KM_USER0);
-		goto memstore;
+	/* Storage allocated on a previous pass must fit exactly */
+	if (handle && alloc_len != clen) {
+		zs_free(zram->mem_pool, handle);
+		handle = NULL;
 	}
 
-	if (xv_malloc(zram->mem_pool, clen + sizeof(*zheader),
-		      &zram->table[index].page, &store_offset,
-		      GFP_NOIO | __GFP_HIGHMEM)) {
-		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
-		goto out;
+	if (!handle)
+		handle = zs_malloc(zram->mem_pool, clen,
+				   GFP_NOWAIT | __GFP_HIGHMEM | __GFP_NOWARN);
+	if (!handle) {
+		/*
+		 * We cannot sleep while holding the stream. Drop it,
+		 * allocate with reclaim allowed and compress again.
+		 */
+		zcomp_strm_release(zram->comp, zstrm);
+		kunmap_atomic(user_mem, KM_USER0);
+
+		handle = zs_malloc(zram->mem_pool, clen,
+				   GFP_NOIO | __GFP_HIGHMEM);
+		if (!handle) {
+			pr_info("Error allocating memory for compressed "
+				"page: %u, size=%zu\n", index, clen);
+			ret = -ENOMEM;
+			goto out_free;
+		}
+		alloc_len = clen;
+		goto compress_again;
 	}
+	alloc_len = clen;
 
-memstore:
-	zram->table[index].offset = store_offset;
+	cmem = zs_map_object(zram->mem_pool, handle);
+	memcpy(cmem, src, clen);
+	zs_unmap_object(zram->mem_pool, handle);
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
+	zcomp_strm_release(zram->comp, zstrm);
+	kunmap_atomic(user_mem, KM_USER0);
 
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+	stored = handle;
+	handle = NULL;
+
+	if (zram_dedup_enabled(zram)) {
+		entry->handle = stored;
+		entry->len = clen;
+		entry->checksum = checksum;
+		entry->refcount = 1;
+		zram_dedup_insert(zram, entry);
+		stored = entry;
+		entry = NULL;
 	}
-#endif
 
-	memcpy(cmem, src, clen);
+store:
+	zram_slot_lock(zram, index);
 
-	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-		kunmap_atomic(src, KM_USER0);
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	if (zram_allocated(zram, index))
+		zram_free_page(zram, index);
+
+	zram->table[index].handle = stored;
+	zram_set_obj_size(zram, index, clen);
+	if (unlikely(clen == PAGE_SIZE)) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
+	}
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
-	return 0;
+	zram_slot_unlock(zram, index);
 
+out_free:
+	if (is_partial_io(bvec))
+		kfree(uncmem);
+	if (handle)
+		zs_free(zram->mem_pool, handle);
+	kfree(entry);
 out:
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static int zram_wb_candidate(struct zram *zram, u32 index,
+			     enum zram_wb_mode mode)
+{
+	if (!zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		return 0;
+
+	if (mode == ZRAM_WB_HUGE)
+		return zram_test_flag(zram, index, ZRAM_UNCOMPRESSED);
+
+	return zram_test_flag(zram, index, ZRAM_IDLE);
+}
+
+/*
+ * Write one batch of pages to the backing device, merging pages that
+ * got consecutive blocks into a single bio.
+ */
+static int zram_wb_submit(struct zram *zram, struct page **pages,
+			  unsigned long *blks, int n)
+{
+	int i;
+	struct bio *bio = NULL;
+	struct zram_bd_batch batch;
+
+	zram_bd_batch_init(&batch);
+	for (i = 0; i < n; i++) {
+		if (bio && blks[i] == blks[i - 1] + 1 &&
+		    bio_add_page(bio, pages[i], PAGE_SIZE, 0) == PAGE_SIZE)
+			continue;
+
+		if (bio)
+			submit_bio(WRITE, bio);
+		bio = zram_bd_bio_alloc(zram, blks[i], n - i, &batch);
+		bio_add_page(bio, pages[i], PAGE_SIZE, 0);
+	}
+	if (bio)
+		submit_bio(WRITE, bio);
+
+	return zram_bd_batch_wait(&batch);
+}
+
+/*
+ * Move pages selected by 'mode' to the backing device, freeing the
+ * memory they use. Pages are copied out under the slot lock, written
+ * without it, and only dropped from memory if they were not modified
+ * meanwhile (ZRAM_UNDER_WB is cleared whenever a page is freed).
+ */
+int zram_writeback(struct zram *zram, enum zram_wb_mode mode)
+{
+	int i, n, ret = 0, err;
+	u32 index, nr_index;
+	u32 indices[ZRAM_WB_BATCH];
+	unsigned long blks[ZRAM_WB_BATCH];
+	struct page *pages[ZRAM_WB_BATCH];
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done || !zram->bdev) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	nr_index = zram->disksize >> PAGE_SHIFT;
+	index = 0;
+	while (index < nr_index && !ret) {
+		n = 0;
+		for (; index < nr_index && n < ZRAM_WB_BATCH; index++) {
+			zram_slot_lock(zram, index);
+			if (!zram_wb_candidate(zram, index, mode)) {
+				zram_slot_unlock(zram, index);
+				continue;
+			}
+
+			blks[n] = zram_bd_alloc_blk(zram);
+			if (!blks[n]) {
+				zram_slot_unlock(zram, index);
+				ret = -ENOSPC;
+				break;
+			}
+
+			err = zram_decompress_page(zram,
+					page_address(pages[n]), index);
+			if (err) {
+				zram_slot_unlock(zram, index);
+				zram_bd_free_blk(zram, blks[n]);
+				ret = err;
+				break;
+			}
+			zram_set_flag(zram, index, ZRAM_UNDER_WB);
+			zram_slot_unlock(zram, index);
+
+			indices[n++] = index;
+		}
+
+		if (!n)
+			break;
+
+		err = zram_wb_submit(zram, pages, blks, n);
+		if (err) {
+			pr_err("Write to backing device failed! err=%d\n",
+				err);
+			ret = err;
+		}
+
+		for (i = 0; i < n; i++) {
+			zram_slot_lock(zram, indices[i]);
+			if (!err &&
+			    zram_test_flag(zram, indices[i], ZRAM_UNDER_WB)) {
+				zram_free_page(zram, indices[i]);
+				zram_set_flag(zram, indices[i], ZRAM_WB);
+				zram->table[indices[i]].element = blks[i];
+				zram_stat64_inc(zram, &zram->stats.bd_count);
+				zram_stat64_inc(zram, &zram->stats.bd_writes);
+			} else {
+				zram_clear_flag(zram, indices[i],
+						ZRAM_UNDER_WB);
+				zram_bd_free_blk(zram, blks[i]);
+			}
+			zram_slot_unlock(zram, indices[i]);
+		}
+	}
+
+out_unlock:
+	up_read(&zram->init_lock);
+out_free:
+	for (i = 0; i < ZRAM_WB_BATCH && pages[i]; i++)
+		__free_page(pages[i]);
+
+	return ret;
+}
+
+/* Mark all pages held in memory idle; accessing a page clears it */
+void zram_mark_idle(struct zram *zram)
+{
+	u32 index;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done)
+		goto out;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_allocated(zram, index) &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+	}
+out:
+	up_read(&zram->init_lock);
+}
+
+/* Called with init_lock held for write */
+void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	destroy_workqueue(zram->bd_wq);
+	zram->bd_wq = NULL;
+	close_bdev_exclusive(zram->bdev, FMODE_READ | FMODE_WRITE);
+	zram->bdev = NULL;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+	kfree(zram->backing_dev);
+	zram->backing_dev = NULL;
+}
+
+int zram_set_backing_dev(struct zram *zram, const char *path)
+{
+	int ret;
+	char *name;
+	unsigned long nr_pages, *bitmap = NULL;
+	struct block_device *bdev;
+	struct workqueue_struct *wq = NULL;
+
+	name = kstrdup(path, GFP_KERNEL);
+	if (!name)
+		return -ENOMEM;
+	strim(name);
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Can't setup backing device for initialized device\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	bdev = open_bdev_exclusive(name, FMODE_READ | FMODE_WRITE, zram);
+	if (IS_ERR(bdev)) {
+		ret = PTR_ERR(bdev);
+		goto out;
+	}
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	wq = create_singlethread_workqueue("zram_bd");
+	if (nr_pages < 2 || !bitmap || !wq) {
+		ret = nr_pages < 2 ? -EINVAL : -ENOMEM;
+		close_bdev_exclusive(bdev, FMODE_READ | FMODE_WRITE);
+		goto out;
+	}
+
+	zram_reset_bdev(zram);
+	spin_lock_init(&zram->bitmap_lock);
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	zram->bd_wq = wq;
+	zram->backing_dev = name;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", name);
+	return 0;
+
+out:
+	up_write(&zram->init_lock);
+	if (wq)
+		destroy_workqueue(wq);
+	vfree(bitmap);
+	kfree(name);
+	return ret;
+}
+#endif
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
 	int ret;
 
 	if (rw == READ) {
-		down_read(&zram->lock);
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -568,6 +1312,114 @@ out:
 	bio_io_error(bio);
 }
 
+/* A multi-page read, spread over the per-CPU read workers */
+struct zram_read_io {
+	struct zram *zram;
+	struct bio *bio;
+	atomic_t pending;
+	int error;
+};
+
+struct zram_read_work {
+	struct work_struct work;
+	struct zram_read_io *io;
+	struct bio_vec *bvec;
+	u32 index;
+};
+
+static void zram_read_work_fn(struct work_struct *work)
+{
+	struct zram_read_work *rw =
+		container_of(work, struct zram_read_work, work);
+	struct zram_read_io *io = rw->io;
+	struct zram *zram = io->zram;
+	int ret;
+
+	ret = zram_bvec_read(zram, rw->bvec, rw->index, 0, io->bio);
+	if (ret)
+		io->error = ret;
+
+	/* The last page to finish completes the bio */
+	if (!atomic_dec_and_test(&io->pending))
+		return;
+
+	if (io->error) {
+		bio_io_error(io->bio);
+	} else {
+		set_bit(BIO_UPTODATE, &io->bio->bi_flags);
+		bio_endio(io->bio, 0);
+	}
+	kfree(io);
+
+	if (atomic_dec_and_test(&zram->inflight_reads))
+		wake_up(&zram->io_wait);
+}
+
+/*
+ * Hand each page of a read bio to a different CPU's worker, so that
+ * the pages of e.g. a readahead window are decompressed in parallel;
+ * the bio completes once all of them are done. Returns 0 if the bio
+ * does not qualify, and has to be handled synchronously: single page
+ * reads, such as those of swap-in, would only pay for a context switch.
+ */
+static int zram_async_read(struct zram *zram, struct bio *bio)
+{
+	int i, cpu, nr_pages = 0;
+	u32 index;
+	struct bio_vec *bvec;
+	struct zram_read_io *io;
+	struct zram_read_work *rw;
+
+	if (!zram->async_reads || !zram_read_wq)
+		return 0;
+
+	if (bio->bi_sector & (SECTORS_PER_PAGE - 1))
+		return 0;
+
+	bio_for_each_segment(bvec, bio, i) {
+		if (bvec->bv_len != PAGE_SIZE)
+			return 0;
+		nr_pages++;
+	}
+
+	if (nr_pages < 2)
+		return 0;
+
+	io = kmalloc(sizeof(*io) + nr_pages * sizeof(*rw), GFP_NOIO);
+	if (!io)
+		return 0;
+
+	zram_stat64_inc(zram, &zram->stats.num_reads);
+
+	io->zram = zram;
+	io->bio = bio;
+	io->error = 0;
+	atomic_set(&io->pending, nr_pages);
+	atomic_inc(&zram->inflight_reads);
+
+	rw = (struct zram_read_work *)(io + 1);
+	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
+
+	/* Works queued on a CPU going offline would never run */
+	get_online_cpus();
+	cpu = raw_smp_processor_id();
+	bio_for_each_segment(bvec, bio, i) {
+		INIT_WORK(&rw->work, zram_read_work_fn);
+		rw->io = io;
+		rw->bvec = bvec;
+		rw->index = index++;
+		queue_work_on(cpu, zram_read_wq, &rw->work);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		rw++;
+	}
+	put_online_cpus();
+
+	return 1;
+}
+
 /*
  * Check if request is within bounds and aligned on zram logical blocks.
  */
@@ -604,7 +1456,8 @@ static int zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto error_unlock;
 	}
 
-	__zram_make_request(zram, bio, bio_data_dir(bio));
+	if (bio_data_dir(bio) != READ || !zram_async_read(zram, bio))
+		__zram_make_request(zram, bio, bio_data_dir(bio));
 	up_read(&zram->init_lock);
 
 	return 0;
@@ -622,34 +1475,38 @@ void __zram_reset_device(struct zram *zram)
 
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+	/* Wait for reads still running on the read workers */
+	wait_event(zram->io_wait, !atomic_read(&zram->inflight_reads));
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free various per-device buffers */
+	if (zram->comp)
+		zcomp_destroy(zram->comp);
+	zram->comp = NULL;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
+		void *handle = zram->table[index].handle;
 
-		page = zram->table[index].page;
-		offset = zram->table[index].offset;
-
-		if (!page)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
-		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-			__free_page(page);
+		if (zram_dedup_enabled(zram))
+			zram_entry_put(zram, zram->table[index].entry);
 		else
-			xv_free(zram->mem_pool, page, offset);
+			zs_free(zram->mem_pool, handle);
 	}
 
 	vfree(zram->table);
 	zram->table = NULL;
 
-	xv_destroy_pool(zram->mem_pool);
+	zram_dedup_fini(zram);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_reset_bdev(zram);
+#endif
+
+	if (zram->mem_pool)
+		zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
 	/* Reset stats */
@@ -677,17 +1534,9 @@ int zram_init_device(struct zram *zram)
 		return 0;
 	}
 
-	zram->compress_workmem = kzalloc(WMSIZE, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
+	zram->comp = zcomp_create(zram->compressor);
+	if (!zram->comp) {
+		pr_err("Error allocating compression streams\n");
 		ret = -ENOMEM;
 		goto fail_no_table;
 	}
@@ -703,13 +1552,21 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = xv_create_pool();
+	zram->mem_pool = zs_create_pool("zram");
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
 
+	if (zram_dedup_enabled(zram)) {
+		ret = zram_dedup_init(zram, num_pages);
+		if (ret) {
+			pr_err("Error allocating dedup hash table\n");
+			goto fail;
+		}
+	}
+
 	zram->init_done = 1;
 	up_write(&zram->init_lock);
 
@@ -732,7 +1589,9 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	zram_slot_lock(zram, index);
 	zram_free_page(zram, index);
+	zram_slot_unlock(zram, index);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -745,9 +1604,12 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
+	init_waitqueue_head(&zram->io_wait);
+	atomic_set(&zram->inflight_reads, 0);
+	zram->async_reads = 1;
 	spin_lock_init(&zram->stat64_lock);
+	zram->compressor = default_compressor;
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -794,6 +1656,15 @@ static int create_device(struct zram *zram, int device_id)
 	blk_queue_io_min(zram->disk->queue, PAGE_SIZE);
 	blk_queue_io_opt(zram->disk->queue, PAGE_SIZE);
 
+	/* I/O can come in as soon as the disk is added */
+	ret = zram_lock_stat_init(zram);
+	if (ret < 0) {
+		put_disk(zram->disk);
+		blk_cleanup_queue(zram->queue);
+		pr_warning("Error allocating lock stats");
+		goto out;
+	}
+
 	add_disk(zram->disk);
 
 	ret = sysfs_create_group(&disk_to_dev(zram->disk)->kobj,
@@ -821,6 +1692,8 @@ static void destroy_device(struct zram *zram)
 
 	if (zram->queue)
 		blk_cleanup_queue(zram->queue);
+
+	zram_lock_stat_fini(zram);
 }
 
 static int __init zram_init(void)
@@ -841,11 +1714,18 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	zram_read_wq = create_workqueue("zram_read");
+	if (!zram_read_wq) {
+		pr_warning("Unable to create read workqueue\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warning("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto destroy_wq;
 	}
 
 	/* Allocate the device array and initialize each one */
@@ -858,6 +1738,7 @@ static int __init zram_init(void)
 		goto unregister;
 	}
 
+	zram_debugfs_create();
 	for (dev_id = 0; dev_id < zram_num_devices; dev_id++) {
 		ret = create_device(&zram_devices[dev_id], dev_id);
 		if (ret)
@@ -869,9 +1750,12 @@ static int __init zram_init(void)
 free_devices:
 	while (dev_id)
 		destroy_device(&zram_devices[--dev_id]);
+	zram_debugfs_destroy();
 	kfree(zram_devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+destroy_wq:
+	destroy_workqueue(zram_read_wq);
 out:
 	return ret;
 }
@@ -887,9 +1771,14 @@ static void __exit zram_exit(void)
 		destroy_device(zram);
 		if (zram->init_done)
 			zram_reset_device(zram);
+#ifdef CONFIG_ZRAM_WRITEBACK
+		zram_reset_bdev(zram);
+#endif
 	}
+	zram_debugfs_destroy();
 
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_read_wq);
 
 	kfree(zram_devices);
 	pr_debug("Cleanup done!\n");
@@ -17,8 +17,11 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/wait.h>
 
-#include "xvmalloc.h"
+#include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -26,18 +29,6 @@
  */
 static const unsigned max_num_devices = 32;
 
-/*
- * Stored at beginning of each compressed object.
- *
- * It stores back-reference to table entry which points to this
- * object. This is required to support memory defragmentation.
- */
-struct zobj_header {
-#if 0
-	u32 table_idx;
-#endif
-};
-
 /*-- Configurable parameters */
 
 /* Default zram disk size: 25% of total RAM */
@@ -51,8 +42,8 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /*
  * NOTE: max_zpage_size must be less than or equal to:
- *   XV_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
- * otherwise, xv_malloc() would always return failure.
+ *   ZS_MAX_ALLOC_SIZE
+ * otherwise, zs_malloc() would always return failure.
  */
 
 /*-- End of configurable params */
@@ -66,26 +57,63 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
-/* Flags for zram pages (table[page_no].flags) */
+/*
+ * The lower ZRAM_FLAG_SHIFT bits of table.value hold the object size,
+ * the higher bits the zram_pageflags.
+ */
+#define ZRAM_FLAG_SHIFT		(PAGE_SHIFT + 1)
+
+/* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
+	/* Page slot is locked, see zram_slot_lock() */
+	ZRAM_LOCK = ZRAM_FLAG_SHIFT,
+
 	/* Page is stored uncompressed */
 	ZRAM_UNCOMPRESSED,
 
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/*
+	 * Page is filled with a single repeated word, kept in
+	 * table[page_no].element instead of an allocated object
+	 */
+	ZRAM_SAME,
+
+	/*
+	 * Page is stored on the backing device, at the block kept in
+	 * table[page_no].element
+	 */
+	ZRAM_WB,
+
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+
+	/* Page was not accessed since it was last marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+#ifdef CONFIG_ZRAM_LOCK_STAT
+/* log2 histograms of slot lock wait and hold times, in ns */
+#define ZRAM_LOCK_STAT_BUCKETS	32
+
+struct zram_lock_stat {
+	u64 wait[ZRAM_LOCK_STAT_BUCKETS];
+	u64 hold[ZRAM_LOCK_STAT_BUCKETS];
+	u64 acquired;	/* sched_clock() when the held lock was taken */
+};
+#endif
+
 /* Allocated for each disk page */
 struct table {
-	struct page *page;
-	u16 offset;
-	u8 count;	/* object ref count (not yet used) */
-	u8 flags;
-} __attribute__((aligned(4)));
+	union {
+		void *handle;	/* zsmalloc handle of the stored object */
+		struct zram_entry *entry;	/* when deduplicating */
+		unsigned long element;	/* ZRAM_SAME fill word, ZRAM_WB block */
+	};
+	unsigned long value;	/* object size, and flags */
+};
 
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
@@ -95,20 +123,24 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
-	u32 pages_zero;		/* no. of zero filled pages */
-	u32 pages_stored;	/* no. of pages currently stored */
-	u32 good_compress;	/* % of pages with compression ratio<=50% */
-	u32 pages_expand;	/* % of incompressible pages */
+	atomic_t pages_zero;	/* no. of zero filled pages */
+	atomic_t pages_same;	/* no. of same filled pages, zero included */
+	atomic_t pages_stored;	/* no. of pages currently stored */
+	atomic_t good_compress;	/* % of pages with compression ratio<=50% */
+	atomic_t pages_expand;	/* % of incompressible pages */
+	u64 pages_deduped;	/* no. of pages sharing another's object */
+	u64 dedup_bytes_saved;	/* compressed bytes not stored thanks to it */
+	u64 bd_count;		/* no. of pages on the backing device */
+	u64 bd_reads;		/* no. of pages read from the backing device */
+	u64 bd_writes;		/* no. of pages written to the backing device */
 };
 
 struct zram {
-	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zs_pool *mem_pool;
+	struct zcomp *comp;	/* per-CPU compression streams */
+	const char *compressor;	/* backend selected via comp_algorithm */
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -120,9 +152,49 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 
+	/* Same page deduplication (see zram_dedup.c) */
+	int use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Backing device for idle and incompressible pages */
+	struct block_device *bdev;
+	char *backing_dev;	/* its path, as written to sysfs */
+	unsigned long *bitmap;	/* used blocks, block 0 is never used */
+	unsigned long nr_pages;	/* size of the device in blocks */
+	spinlock_t bitmap_lock;
+	struct workqueue_struct *bd_wq;
+#endif
+
+	/* Spread whole-page reads over the per-CPU read workers */
+	int async_reads;
+	atomic_t inflight_reads;	/* bios being read by the workers */
+	wait_queue_head_t io_wait;	/* for inflight_reads to drop */
+
+#ifdef CONFIG_ZRAM_LOCK_STAT
+	struct zram_lock_stat __percpu *lock_stat;
+	struct dentry *debugfs_file;
+#endif
+
 	struct zram_stats stats;
 };
 
+/* What zram_writeback() writes to the backing device */
+enum zram_wb_mode {
+	ZRAM_WB_HUGE,	/* incompressible pages */
+	ZRAM_WB_IDLE,	/* pages not accessed since marked idle */
+};
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	return zram->use_dedup;
+#else
+	return false;
+#endif
+}
+
 extern struct zram *zram_devices;
 extern unsigned int zram_num_devices;
 #ifdef CONFIG_SYSFS
@@ -132,4 +204,11 @@ extern struct attribute_group zram_disk_attr_group;
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+extern int zram_set_backing_dev(struct zram *zram, const char *path);
+extern void zram_reset_bdev(struct zram *zram);
+extern void zram_mark_idle(struct zram *zram);
+extern int zram_writeback(struct zram *zram, enum zram_wb_mode mode);
+#endif
+
 #endif
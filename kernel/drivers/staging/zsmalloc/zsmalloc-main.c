@@ -22,11 +22,8 @@
 #include <linux/init.h>
 #include <linux/string.h>
 #include <linux/slab.h>
-#include <asm/tlbflush.h>
-#include <asm/pgtable.h>
 #include <linux/cpumask.h>
 #include <linux/cpu.h>
-#include <linux/vmalloc.h>
 
 #include "zsmalloc.h"
 #include "zsmalloc_int.h"
@@ -40,7 +37,14 @@
 #define CLASS_IDX_MASK	((1 << CLASS_IDX_BITS) - 1)
 #define FULLNESS_MASK	((1 << FULLNESS_BITS) - 1)
 
-/* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
+/*
+ * per-cpu bounce buffers for zspage accesses that cross page boundaries.
+ *
+ * Objects spanning two pages are copied into this buffer by zs_map_object()
+ * and copied back by zs_unmap_object(). Unlike remapping the two pages into
+ * a virtually contiguous area, this does not depend on arch-specific page
+ * table helpers, so it works on every architecture.
+ */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
 static int is_first_page(struct page *page)
@@ -323,7 +327,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		if (page != first_page)
 			page->index = off;
 
-		link = (struct link_free *)kmap_atomic(page) +
+		link = (struct link_free *)kmap_atomic(page, ZS_KM_SLOT) +
 						off / sizeof(*link);
 		objs_on_page = (PAGE_SIZE - off) / class->size;
 
@@ -342,7 +346,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 */
 		next_page = get_next_page(page);
 		link->next = obj_location_to_handle(next_page, 0);
-		kunmap_atomic(link);
+		kunmap_atomic(link, ZS_KM_SLOT);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
 	}
@@ -425,12 +429,6 @@ static struct page *find_get_zspage(struct size_class *class)
 }
 
 
-/*
- * If this becomes a separate module, register zs_init() with
- * module_init(), zs_exit with module_exit(), and remove zs_initialized
-*/
-static int zs_initialized;
-
 static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 				void *pcpu)
 {
@@ -440,18 +438,18 @@ static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 	switch (action) {
 	case CPU_UP_PREPARE:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
+		if (area->vm_buf)
 			break;
-		area->vm = alloc_vm_area(2 * PAGE_SIZE, area->vm_ptes);
-		if (!area->vm)
+		area->vm_buf = (char *)__get_free_page(GFP_KERNEL);
+		if (!area->vm_buf)
 			return notifier_from_errno(-ENOMEM);
 		break;
 	case CPU_DEAD:
 	case CPU_UP_CANCELED:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
-			free_vm_area(area->vm);
-		area->vm = NULL;
+		if (area->vm_buf)
+			free_page((unsigned long)area->vm_buf);
+		area->vm_buf = NULL;
 		break;
 	}
 
@@ -487,9 +485,9 @@ fail:
 	return notifier_to_errno(ret);
 }
 
-struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
+struct zs_pool *zs_create_pool(const char *name)
 {
-	int i, error, ovhd_size;
+	int i, ovhd_size;
 	struct zs_pool *pool;
 
 	if (!name)
@@ -516,28 +514,8 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 
 	}
 
-	/*
-	 * If this becomes a separate module, register zs_init with
-	 * module_init, and remove this block
-	*/
-	if (!zs_initialized) {
-		error = zs_init();
-		if (error)
-			goto cleanup;
-		zs_initialized = 1;
-	}
-
-	pool->flags = flags;
 	pool->name = name;
 
-	error = 0; /* Success */
-
-cleanup:
-	if (error) {
-		zs_destroy_pool(pool);
-		pool = NULL;
-	}
-
 	return pool;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
@@ -566,12 +544,13 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  * zs_malloc - Allocate block of given size from pool.
  * @pool: pool to allocate from
  * @size: size of block to allocate
+ * @flags: gfp flags used if the pool has to grow
  *
  * On success, handle to the allocated object is returned,
  * otherwise NULL.
  * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
  */
-void *zs_malloc(struct zs_pool *pool, size_t size)
+void *zs_malloc(struct zs_pool *pool, size_t size, gfp_t flags)
 {
 	void *obj;
 	struct link_free *link;
@@ -593,7 +572,7 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 
 	if (!first_page) {
 		spin_unlock(&class->lock);
-		first_page = alloc_zspage(class, pool->flags);
+		first_page = alloc_zspage(class, flags);
 		if (unlikely(!first_page))
 			return NULL;
 
@@ -606,11 +585,11 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 	obj_handle_to_location(obj, &m_page, &m_objidx);
 	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
 
-	link = (struct link_free *)kmap_atomic(m_page) +
+	link = (struct link_free *)kmap_atomic(m_page, ZS_KM_SLOT) +
 					m_offset / sizeof(*link);
 	first_page->freelist = link->next;
 	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
+	kunmap_atomic(link, ZS_KM_SLOT);
 
 	first_page->inuse++;
 	/* Now move the zspage to another fullness group, if required */
@@ -644,10 +623,10 @@ void zs_free(struct zs_pool *pool, void *obj)
 	spin_lock(&class->lock);
 
 	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page,
+						ZS_KM_SLOT) + f_offset);
 	link->next = first_page->freelist;
-	kunmap_atomic(link);
+	kunmap_atomic(link, ZS_KM_SLOT);
 	first_page->freelist = obj;
 
 	first_page->inuse--;
@@ -663,6 +642,34 @@ void zs_free(struct zs_pool *pool, void *obj)
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/*
+ * Copy an object spanning two pages into the per-cpu bounce buffer, or
+ * (on unmap) copy it back to where it lives.
+ */
+static void zs_copy_object(struct mapping_area *area, struct page *pages[2],
+				int off, int size, bool to_buf)
+{
+	int sizes[2];
+	char *addr;
+
+	sizes[0] = PAGE_SIZE - off;
+	sizes[1] = size - sizes[0];
+
+	addr = kmap_atomic(pages[0], ZS_KM_SLOT);
+	if (to_buf)
+		memcpy(area->vm_buf, addr + off, sizes[0]);
+	else
+		memcpy(addr + off, area->vm_buf, sizes[0]);
+	kunmap_atomic(addr, ZS_KM_SLOT);
+
+	addr = kmap_atomic(pages[1], ZS_KM_SLOT);
+	if (to_buf)
+		memcpy(area->vm_buf + sizes[0], addr, sizes[1]);
+	else
+		memcpy(addr, area->vm_buf + sizes[0], sizes[1]);
+	kunmap_atomic(addr, ZS_KM_SLOT);
+}
+
 /**
  * zs_map_object - get address of allocated object from handle.
  * @pool: pool from which the object was allocated
@@ -671,6 +678,10 @@ EXPORT_SYMBOL_GPL(zs_free);
  * Before using an object allocated from zs_malloc, it must be mapped using
  * this function. When done with the object, it must be unmapped using
  * zs_unmap_object
+ *
+ * Only one object can be mapped per cpu at a time. Preemption is disabled
+ * until the object is unmapped, and the ZS_KM_SLOT atomic kmap slot is in
+ * use in the meantime, so callers must not hold it themselves.
 */
 void *zs_map_object(struct zs_pool *pool, void *handle)
 {
@@ -681,6 +692,7 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 	enum fullness_group fg;
 	struct size_class *class;
 	struct mapping_area *area;
+	struct page *pages[2];
 
 	BUG_ON(!handle);
 
@@ -692,23 +704,19 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 	area = &get_cpu_var(zs_map_area);
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
-		area->vm_addr = kmap_atomic(page);
-	} else {
-		/* this object spans two pages */
-		struct page *nextp;
-
-		nextp = get_next_page(page);
-		BUG_ON(!nextp);
-
+		area->vm_addr = kmap_atomic(page, ZS_KM_SLOT);
+		return area->vm_addr + off;
+	}
 
-		set_pte(area->vm_ptes[0], mk_pte(page, PAGE_KERNEL));
-		set_pte(area->vm_ptes[1], mk_pte(nextp, PAGE_KERNEL));
+	/* this object spans two pages */
+	pages[0] = page;
+	pages[1] = get_next_page(page);
+	BUG_ON(!pages[1]);
 
-		/* We pre-allocated VM area so mapping can never fail */
-		area->vm_addr = area->vm->addr;
-	}
+	zs_copy_object(area, pages, off, class->size, true);
+	area->vm_addr = NULL;
 
-	return area->vm_addr + off;
+	return area->vm_buf;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
@@ -721,6 +729,7 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 	enum fullness_group fg;
 	struct size_class *class;
 	struct mapping_area *area;
+	struct page *pages[2];
 
 	BUG_ON(!handle);
 
@@ -731,12 +740,13 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 
 	area = &__get_cpu_var(zs_map_area);
 	if (off + class->size <= PAGE_SIZE) {
-		kunmap_atomic(area->vm_addr);
+		kunmap_atomic(area->vm_addr, ZS_KM_SLOT);
 	} else {
-		set_pte(area->vm_ptes[0], __pte(0));
-		set_pte(area->vm_ptes[1], __pte(0));
-		__flush_tlb_one((unsigned long)area->vm_addr);
-		__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
+		pages[0] = page;
+		pages[1] = get_next_page(page);
+		BUG_ON(!pages[1]);
+
+		zs_copy_object(area, pages, off, class->size, false);
 	}
 	put_cpu_var(zs_map_area);
 }
@@ -753,3 +763,9 @@ u64 zs_get_total_size_bytes(struct zs_pool *pool)
 	return npages << PAGE_SHIFT;
 }
 EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
+
+module_init(zs_init);
+module_exit(zs_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_AUTHOR("Nitin Gupta <ngupta@vflare.org>");
@@ -109,10 +109,14 @@ enum fullness_group {
  */
 static const int fullness_threshold_frac = 4;
 
+/*
+ * Atomic kmap slot used for all zspage accesses; see zs_map_object().
+ */
+#define ZS_KM_SLOT	KM_USER1
+
 struct mapping_area {
-	struct vm_struct *vm;
-	pte_t *vm_ptes[2];
-	char *vm_addr;
+	char *vm_buf;	/* copy buffer for objects spanning two pages */
+	char *vm_addr;	/* address of kmap'ed object in a single page */
 };
 
 struct size_class {
@@ -148,7 +152,6 @@ struct link_free {
 struct zs_pool {
 	struct size_class size_class[ZS_SIZE_CLASSES];
 
-	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
 };
 
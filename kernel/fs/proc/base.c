@@ -355,6 +355,27 @@ static int proc_pid_stack(struct seq_file *m, struct pid_namespace *ns,
 }
 #endif
 
+#ifdef CONFIG_KSM
+/*
+ * Provides /proc/PID/ksm_stat: how much of this process ksmd tracks,
+ * has merged and has scanned, in pages
+ */
+static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
+			     struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (mm) {
+		seq_printf(m, "ksm_rmap_items %lu\n", mm->ksm_rmap_items);
+		seq_printf(m, "ksm_merging_pages %lu\n", mm->ksm_merging_pages);
+		seq_printf(m, "ksm_pages_scanned %lu\n", mm->ksm_pages_scanned);
+		mmput(mm);
+	}
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 /*
  * Provides /proc/PID/schedstat
@@ -1049,6 +1070,7 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 	task->signal->oom_adj = oom_adjust;
 
 	unlock_task_sighand(task, &flags);
+	oom_adj_notify(OOM_ADJ_CHANGE, task);
 	put_task_struct(task);
 
 	return count;
@@ -2715,6 +2737,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps",      S_IRUGO, proc_smaps_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",   S_IRUSR, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -3049,6 +3074,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	REG("smaps",     S_IRUGO, proc_smaps_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",  S_IRUSR, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",      S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -0,0 +1,183 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * benchmark.c
+ */
+
+/*
+ * This file times the decompressor of a filesystem when it is mounted,
+ * to compare the decompressors on the same image built with each of them
+ * (mksquashfs -comp).
+ *
+ * The fragment blocks, or the inode table if there are none, are read once
+ * to get them into the buffer cache, and then decompressed again.  Only the
+ * second pass is timed, so the result is the decompression throughput, not
+ * that of the device.  bench_blocks limits the number of blocks read, 0
+ * disables the benchmark.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/pagemap.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+#include "decompressor.h"
+
+static unsigned int bench_blocks = 32;
+module_param(bench_blocks, uint, 0644);
+MODULE_PARM_DESC(bench_blocks, "Blocks decompressed at mount to time the "
+	"decompressor, 0 to disable");
+
+struct squashfs_bench {
+	void		**data;
+	int		pages;
+	int		srclength;
+	int		blocks;
+	u64		in;
+	u64		out;
+};
+
+/*
+ * Read the blocks at start[i] of size[i] (0 for metadata blocks), and
+ * return the time taken in ns, or a negative error
+ */
+static s64 bench_pass(struct super_block *sb, struct squashfs_bench *bench,
+	u64 *start, int *size)
+{
+	ktime_t begin = ktime_get();
+	int i, res;
+
+	bench->in = bench->out = 0;
+	for (i = 0; i < bench->blocks; i++) {
+		u64 next = start[i];
+
+		res = squashfs_read_data(sb, bench->data, start[i], size[i],
+				&next, bench->srclength, bench->pages);
+		if (res < 0)
+			return res;
+		bench->in += next - start[i];
+		bench->out += res;
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), begin));
+}
+
+
+/*
+ * Collect up to max compressed fragment blocks, or failing that metadata
+ * blocks of the inode table, reading them into the buffer cache
+ */
+static int bench_find_blocks(struct super_block *sb,
+	struct squashfs_bench *bench, unsigned int fragments, int max,
+	u64 *start, int *size)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	u64 block = msblk->inode_table;
+	int i, res;
+
+	for (i = 0; i < fragments && bench->blocks < max; i++) {
+		res = squashfs_frag_lookup(sb, i, &start[bench->blocks]);
+		if (res < 0)
+			return res;
+		if (!SQUASHFS_COMPRESSED_BLOCK(res))
+			continue;
+		size[bench->blocks++] = res;
+	}
+	if (bench->blocks)
+		return bench_pass(sb, bench, start, size) < 0 ? -EIO : 0;
+
+	/* Metadata blocks are chained, the next is found by reading one */
+	while (block < msblk->directory_table && bench->blocks < max) {
+		start[bench->blocks] = block;
+		size[bench->blocks++] = 0;
+		res = squashfs_read_data(sb, bench->data, block, 0, &block,
+				bench->srclength, bench->pages);
+		if (res < 0)
+			return res;
+	}
+	return 0;
+}
+
+
+void squashfs_benchmark(struct super_block *sb, unsigned int fragments)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_bench bench;
+	int max = bench_blocks, *size = NULL, i, err = -ENOMEM;
+	u64 *start = NULL, mbps;
+	s64 ns;
+
+	if (max <= 0)
+		return;
+
+	bench.blocks = 0;
+	bench.srclength = max_t(int, msblk->block_size,
+						SQUASHFS_METADATA_SIZE);
+	bench.pages = bench.srclength >> PAGE_CACHE_SHIFT;
+	bench.data = kcalloc(bench.pages, sizeof(void *), GFP_KERNEL);
+	if (bench.data == NULL)
+		goto out;
+	for (i = 0; i < bench.pages; i++) {
+		bench.data[i] = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+		if (bench.data[i] == NULL)
+			goto out;
+	}
+	start = kcalloc(max, sizeof(*start), GFP_KERNEL);
+	size = kcalloc(max, sizeof(*size), GFP_KERNEL);
+	if (start == NULL || size == NULL)
+		goto out;
+
+	err = bench_find_blocks(sb, &bench, fragments, max, start, size);
+	if (err)
+		goto out;
+	if (bench.blocks == 0) {
+		WARNING("%s: no compressed blocks to benchmark\n",
+						msblk->decompressor->name);
+		goto out;
+	}
+
+	ns = bench_pass(sb, &bench, start, size);
+	if (ns < 0) {
+		err = ns;
+		goto out;
+	}
+
+	/* bytes per ns * 1000 is MB/s */
+	mbps = div64_u64(bench.out * 1000, max_t(u64, ns, 1));
+	printk(KERN_INFO "SQUASHFS: %s: %d %s blocks, %llu KiB to %llu KiB "
+		"in %llu us, %llu MB/s\n", msblk->decompressor->name,
+		bench.blocks, size[0] ? "fragment" : "metadata",
+		bench.in >> 10, bench.out >> 10, div_u64(ns, NSEC_PER_USEC),
+		mbps);
+
+out:
+	if (err)
+		WARNING("decompressor benchmark failed (%d)\n", err);
+	kfree(size);
+	kfree(start);
+	if (bench.data)
+		for (i = 0; i < bench.pages; i++)
+			kfree(bench.data[i]);
+	kfree(bench.data);
+}
@@ -81,6 +81,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			 * go to sleep waiting for one to become available.
 			 */
 			if (cache->unused == 0) {
+				cache->waits++;
 				cache->num_waiters++;
 				spin_unlock(&cache->lock);
 				wait_event(cache->wait_queue, cache->unused);
@@ -108,6 +109,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			 * Initialise choosen cache entry, and fill it in from
 			 * disk.
 			 */
+			cache->misses++;
 			cache->unused--;
 			entry->block = block;
 			entry->refcount = 1;
@@ -151,12 +153,14 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
 		 * go to sleep waiting for it to become available.
 		 */
 		if (entry->pending) {
+			cache->waits++;
 			entry->num_waiters++;
 			spin_unlock(&cache->lock);
 			wait_event(entry->wait_queue, !entry->pending);
@@ -23,6 +23,8 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -36,13 +38,17 @@
  * Squashfs, allowing multiple decompressors to be easily supported
  */
 
-static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
+#ifndef CONFIG_SQUASHFS_LZMA
+static const struct squashfs_decompressor squashfs_lzma_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
+#endif
 
-static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
+#ifndef CONFIG_SQUASHFS_LZO
+static const struct squashfs_decompressor squashfs_lzo_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#endif
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -50,8 +56,8 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
-	&squashfs_lzma_unsupported_comp_ops,
-	&squashfs_lzo_unsupported_comp_ops,
+	&squashfs_lzma_comp_ops,
+	&squashfs_lzo_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +72,94 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * A decompressor stream can only be used by one decompression at a time.
+ * With CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU each possible cpu gets its own
+ * stream, so that blocks read on different cpus are decompressed in
+ * parallel, otherwise all decompression is serialised on a single stream.
+ *
+ * A stream is only used by the cpu it belongs to, except when a task is
+ * migrated while decompressing, which is why each stream still has its
+ * own mutex.  Decompression can sleep (it waits for the buffer_heads),
+ * so this can't simply disable preemption.
+ */
+struct squashfs_stream {
+	void		*stream;
+	struct mutex	mutex;
+};
+
+#ifdef CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU
+#define SQUASHFS_STREAMS	nr_cpu_ids
+#define for_each_stream(i)	for_each_possible_cpu(i)
+#define this_stream()		raw_smp_processor_id()
+#else
+#define SQUASHFS_STREAMS	1
+#define for_each_stream(i)	for ((i) = 0; (i) < 1; (i)++)
+#define this_stream()		0
+#endif
+
+
+int squashfs_max_decompressors(void)
+{
+#ifdef CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU
+	return num_possible_cpus();
+#else
+	return 1;
+#endif
+}
+
+
+void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream;
+	int i;
+
+	stream = kcalloc(SQUASHFS_STREAMS, sizeof(*stream), GFP_KERNEL);
+	if (stream == NULL)
+		return NULL;
+
+	for_each_stream(i) {
+		mutex_init(&stream[i].mutex);
+		stream[i].stream = msblk->decompressor->init(msblk);
+		if (stream[i].stream == NULL) {
+			squashfs_decompressor_free(msblk, stream);
+			return NULL;
+		}
+	}
+
+	return stream;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *s)
+{
+	struct squashfs_stream *stream = s;
+	int i;
+
+	if (msblk->decompressor == NULL || stream == NULL)
+		return;
+
+	for_each_stream(i)
+		if (stream[i].stream)
+			msblk->decompressor->free(stream[i].stream);
+	kfree(stream);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *stream = msblk->stream;
+	int res;
+
+	stream += this_stream();
+	mutex_lock(&stream->mutex);
+	res = msblk->decompressor->decompress(msblk, stream->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+	mutex_unlock(&stream->mutex);
+
+	return res;
+}
@@ -47,6 +47,10 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/cleancache.h>
+#include <linux/module.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,11 +375,320 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Copy a datablock into the pages from start_index to end_index.  As the
+ * datablock likely covers many PAGE_CACHE_SIZE pages (default block size is
+ * 128 KiB) explicitly grab the pages from the page cache, except for the
+ * page that we've been called to fill (page, if any).
+ */
+static void squashfs_fill_pages(struct address_space *mapping,
+	struct page *page, struct squashfs_cache_entry *buffer,
+	int start_index, int end_index, int bytes, int offset, int sparse)
+{
+	void *pageaddr;
+	int i;
+
+	for (i = start_index; i <= end_index && bytes > 0; i++,
+			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
+		struct page *push_page;
+		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
+
+		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
+
+		push_page = (page && i == page->index) ? page :
+			grab_cache_page_nowait(mapping, i);
+
+		if (!push_page)
+			continue;
+
+		if (PageUptodate(push_page))
+			goto skip_page;
+
+		pageaddr = kmap_atomic(push_page, KM_USER0);
+		squashfs_copy_data(pageaddr, buffer, offset, avail);
+		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap_atomic(pageaddr, KM_USER0);
+		flush_dcache_page(push_page);
+		SetPageUptodate(push_page);
+skip_page:
+		unlock_page(push_page);
+		if (push_page != page)
+			page_cache_release(push_page);
+	}
+}
+
+
+/*
+ * Decompress a datablock straight into its page cache pages, which saves
+ * copying it out of the data cache.  The caller passes the pages it has
+ * locked (nr_target pages in target, possibly none), the other pages of
+ * the block are grabbed and locked here.  Pages already uptodate are not
+ * overwritten, their part of the block is decompressed into a scratch page.
+ *
+ * If any page is locked by someone else, most likely another reader of
+ * the same block, -EAGAIN is returned and the block should be read
+ * through the data cache, where the readers share one decompression.
+ *
+ * On success all pages, including the target pages, are uptodate and
+ * unlocked.  On failure the target pages are left locked.  The caller's
+ * references to the target pages are not dropped either way.
+ */
+static int squashfs_readpage_direct(struct address_space *mapping,
+	struct page **target, int nr_target, u64 block, int bsize,
+	int start_index, int end_index)
+{
+	struct inode *inode = mapping->host;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	DECLARE_BITMAP(grabbed, SQUASHFS_FILE_MAX_SIZE >> PAGE_CACHE_SHIFT);
+	struct page **page, **map, *scratch = NULL;
+	int i, n, pages, avail, res = -ENOMEM;
+	void **buffer, *addr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+	bitmap_zero(grabbed, pages);
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	buffer = kcalloc(pages, sizeof(*buffer), GFP_KERNEL);
+	map = kcalloc(pages, sizeof(*map), GFP_KERNEL);
+	if (page == NULL || buffer == NULL || map == NULL)
+		goto out;
+
+	for (i = 0; i < nr_target; i++) {
+		if (target[i]->index > end_index) {
+			res = -EINVAL;
+			goto release;
+		}
+		page[target[i]->index - start_index] = target[i];
+	}
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		if (page[i])
+			continue;
+		page[i] = grab_cache_page_nowait(mapping, n);
+		if (page[i] == NULL) {
+			res = -EAGAIN;
+			goto release;
+		}
+		__set_bit(i, grabbed);
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+		}
+	}
+
+	/*
+	 * The block is mapped with vmap() rather than a kmap() per page, a
+	 * large block would take hundreds of the pkmap slots and concurrent
+	 * readers, e.g. the readahead workers, could block waiting for more
+	 * while holding theirs.
+	 */
+	for (i = 0; i < pages; i++) {
+		if (page[i]) {
+			map[i] = page[i];
+			continue;
+		}
+		if (scratch == NULL) {
+			scratch = alloc_page(GFP_KERNEL);
+			if (scratch == NULL)
+				goto release;
+		}
+		map[i] = scratch;
+	}
+
+	addr = vmap(map, pages, VM_MAP, PAGE_KERNEL);
+	if (addr == NULL)
+		goto release;
+	for (i = 0; i < pages; i++)
+		buffer[i] = addr + (i << PAGE_CACHE_SHIFT);
+
+	res = squashfs_read_data(inode->i_sb, buffer, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res < 0)
+		goto unmap;
+
+	/* Zero the end of the last page, and any page past the data */
+	for (i = 0; i < pages; i++, res -= avail) {
+		avail = clamp_t(int, res, 0, PAGE_CACHE_SIZE);
+		if (page[i] && avail < PAGE_CACHE_SIZE)
+			memset(buffer[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+	}
+	res = 0;
+
+unmap:
+	flush_kernel_vmap_range(addr, pages << PAGE_CACHE_SHIFT);
+	vunmap(addr);
+	for (i = 0; i < pages && res == 0; i++) {
+		if (page[i] == NULL)
+			continue;
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+	}
+
+release:
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+		if (test_bit(i, grabbed)) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		} else if (res == 0)
+			unlock_page(page[i]);
+	}
+
+out:
+	if (scratch)
+		__free_page(scratch);
+	kfree(map);
+	kfree(buffer);
+	kfree(page);
+	return res;
+}
+
+
+#ifdef CONFIG_SQUASHFS_PARALLEL_READAHEAD
+/*
+ * Parallel readahead.  When a datablock has been read into the page cache,
+ * the following readahead_blocks datablocks of the file are decompressed
+ * into the page cache by a workqueue on the other cpus, so that a
+ * sequential reader finds them there instead of decompressing them
+ * itself, one after the other.
+ */
+static unsigned int readahead_blocks;
+module_param(readahead_blocks, uint, 0644);
+MODULE_PARM_DESC(readahead_blocks, "Datablocks decompressed ahead on other "
+	"cpus, default for new mounts");
+
+static struct workqueue_struct *squashfs_readahead_wq;
+
+struct squashfs_readahead {
+	struct work_struct	work;
+	struct inode		*inode;
+	int			index;
+};
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra = container_of(work,
+					struct squashfs_readahead, work);
+	struct inode *inode = ra->inode;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = ra->index << (msblk->block_log - PAGE_CACHE_SHIFT);
+	struct page *page;
+	u64 block = 0;
+	int bsize;
+
+	/* Nothing to do if the block was read meanwhile */
+	page = find_get_page(inode->i_mapping, start_index);
+	if (page) {
+		page_cache_release(page);
+		goto out;
+	}
+
+	bsize = read_blocklist(inode, ra->index, &block);
+	if (bsize <= 0)
+		goto out;
+
+	/* -EAGAIN: a reader got there first */
+	squashfs_readpage_direct(inode->i_mapping, NULL, 0, block, bsize,
+		start_index, start_index | mask);
+
+out:
+	iput(inode);
+	kfree(ra);
+}
+
+
+static void squashfs_readahead(struct inode *inode, int index)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct squashfs_inode_info *squashfs_inode = squashfs_i(inode);
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int first = index + 1, last, cpu, this_cpu;
+	struct squashfs_readahead *ra;
+
+	if (msblk->readahead_blocks == 0 || num_online_cpus() < 2)
+		return;
+
+	/* Only full datablocks, the file tail is usually a fragment */
+	last = min_t(int, index + msblk->readahead_blocks, file_end - 1);
+
+	/* Don't queue the blocks already queued by the previous block */
+	if (squashfs_inode->readahead_end >= first &&
+			squashfs_inode->readahead_end <= last)
+		first = squashfs_inode->readahead_end + 1;
+	if (first > last)
+		return;
+	squashfs_inode->readahead_end = last;
+
+	this_cpu = cpu = get_cpu();
+	for (; first <= last; first++) {
+		ra = kmalloc(sizeof(*ra), GFP_ATOMIC);
+		if (ra == NULL)
+			break;
+		ra->inode = igrab(inode);
+		if (ra->inode == NULL) {
+			kfree(ra);
+			break;
+		}
+		ra->index = first;
+		INIT_WORK(&ra->work, squashfs_readahead_work);
+
+		/* Spread the blocks over the other online cpus */
+		do {
+			cpu = cpumask_next(cpu, cpu_online_mask);
+			if (cpu >= nr_cpu_ids)
+				cpu = cpumask_first(cpu_online_mask);
+		} while (cpu == this_cpu);
+
+		queue_work_on(cpu, squashfs_readahead_wq, &ra->work);
+		atomic_long_inc(&msblk->readahead_issued);
+	}
+	put_cpu();
+}
+
+
+void squashfs_readahead_mount(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	msblk->readahead_blocks = readahead_blocks;
+}
+
+
+/* Wait for the readahead holding inodes of sb, before unmounting it */
+void squashfs_readahead_umount(struct super_block *sb)
+{
+	flush_workqueue(squashfs_readahead_wq);
+}
+
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_readahead_wq = create_workqueue("squashfs_ra");
+	return squashfs_readahead_wq ? 0 : -ENOMEM;
+}
+
+
+void squashfs_readahead_exit(void)
+{
+	destroy_workqueue(squashfs_readahead_wq);
+}
+#else
+static inline void squashfs_readahead(struct inode *inode, int index)
+{
+}
+#endif
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-	int bytes, i, offset = 0, sparse = 0;
+	int bytes, offset = 0, sparse = 0;
 	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
 
@@ -392,6 +705,17 @@ static int squashfs_readpage(struct file *file, struct page *page)
 					PAGE_CACHE_SHIFT))
 		goto out;
 
+	/*
+	 * A clean page evicted earlier may still be held by cleancache,
+	 * which saves reading and decompressing the whole datablock.
+	 */
+	if (cleancache_get_page(page) == 0) {
+		TRACE("squashfs_readpage: cleancache hit\n");
+		SetPageUptodate(page);
+		unlock_page(page);
+		return 0;
+	}
+
 	if (index < file_end || squashfs_i(inode)->fragment_block ==
 					SQUASHFS_INVALID_BLK) {
 		/*
@@ -410,7 +734,21 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Decompress datablock straight into the page cache.
+			 */
+			int res = squashfs_readpage_direct(page->mapping, &page,
+				1, block, bsize, start_index, end_index);
+			if (res == 0) {
+				if (index < file_end)
+					squashfs_readahead(inode, index);
+				return 0;
+			}
+			if (res != -EAGAIN)
+				goto error_out;
+
+			/*
+			 * Another reader has some of the pages, read and
+			 * decompress datablock through the data cache.
 			 */
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
@@ -442,42 +780,14 @@ static int squashfs_readpage(struct file *file, struct page *page)
 		offset = squashfs_i(inode)->fragment_offset;
 	}
 
-	/*
-	 * Loop copying datablock into pages.  As the datablock likely covers
-	 * many PAGE_CACHE_SIZE pages (default block size is 128 KiB) explicitly
-	 * grab the pages from the page cache, except for the page that we've
-	 * been called to fill.
-	 */
-	for (i = start_index; i <= end_index && bytes > 0; i++,
-			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
-		struct page *push_page;
-		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
-
-		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
-
-		push_page = (i == page->index) ? page :
-			grab_cache_page_nowait(page->mapping, i);
-
-		if (!push_page)
-			continue;
-
-		if (PageUptodate(push_page))
-			goto skip_page;
-
-		pageaddr = kmap_atomic(push_page, KM_USER0);
-		squashfs_copy_data(pageaddr, buffer, offset, avail);
-		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
-		kunmap_atomic(pageaddr, KM_USER0);
-		flush_dcache_page(push_page);
-		SetPageUptodate(push_page);
-skip_page:
-		unlock_page(push_page);
-		if (i != page->index)
-			page_cache_release(push_page);
-	}
+	squashfs_fill_pages(page->mapping, page, buffer, start_index,
+		end_index, bytes, offset, sparse);
 
-	if (!sparse)
+	if (!sparse) {
 		squashfs_cache_put(buffer);
+		if (index < file_end)
+			squashfs_readahead(inode, index);
+	}
 
 	return 0;
 
@@ -496,6 +806,98 @@ out:
 }
 
 
+/*
+ * Read the pages of one datablock, handed over by squashfs_readpages().
+ * They are locked, in the page cache, and in ascending order.
+ */
+static void squashfs_readpages_block(struct file *file, struct page **page,
+	int nr_pages)
+{
+	struct inode *inode = page[0]->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int index = page[0]->index >> (msblk->block_log - PAGE_CACHE_SHIFT);
+	int start_index = page[0]->index & ~mask;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	u64 block = 0;
+	int i, bsize;
+
+	/*
+	 * Decompress the datablock once into all the pages.  Anything else
+	 * (fragments, holes, errors and races) is left to readpage.
+	 */
+	if (index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK) {
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize > 0 && squashfs_readpage_direct(inode->i_mapping,
+				page, nr_pages, block, bsize, start_index,
+				start_index | mask) == 0) {
+			if (index < file_end)
+				squashfs_readahead(inode, index);
+			return;
+		}
+	}
+
+	for (i = 0; i < nr_pages; i++)
+		squashfs_readpage(file, page[i]);
+}
+
+
+/*
+ * Readahead hands over the pages to read in one go.  They are added to the
+ * page cache and grouped by datablock, so that each datablock is only
+ * decompressed once, into pages readahead has already allocated.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	struct page **group, *page;
+	int i, n = 0;
+
+	group = kmalloc((1 << shift) * sizeof(*group), GFP_KERNEL);
+	if (group == NULL)
+		return -ENOMEM;
+
+	while (!list_empty(pages)) {
+		page = list_entry(pages->prev, struct page, lru);
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index,
+					GFP_KERNEL)) {
+			page_cache_release(page);
+			continue;
+		}
+
+		if (cleancache_get_page(page) == 0) {
+			SetPageUptodate(page);
+			unlock_page(page);
+			page_cache_release(page);
+			continue;
+		}
+
+		if (n && (group[0]->index >> shift) != (page->index >> shift)) {
+			squashfs_readpages_block(file, group, n);
+			for (i = 0; i < n; i++)
+				page_cache_release(group[i]);
+			n = 0;
+		}
+		group[n++] = page;
+	}
+
+	if (n) {
+		squashfs_readpages_block(file, group, n);
+		for (i = 0; i < n; i++)
+			page_cache_release(group[i]);
+	}
+
+	kfree(group);
+	return 0;
+}
+
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readpages = squashfs_readpages
 };
@@ -32,6 +32,16 @@ static inline struct squashfs_inode_info *squashfs_i(struct inode *inode)
 	return list_entry(inode, struct squashfs_inode_info, vfs_inode);
 }
 
+/* benchmark.c */
+#ifdef CONFIG_SQUASHFS_BENCHMARK
+extern void squashfs_benchmark(struct super_block *, unsigned int);
+#else
+static inline void squashfs_benchmark(struct super_block *sb,
+				unsigned int fragments)
+{
+}
+#endif
+
 /* block.c */
 extern int squashfs_read_data(struct super_block *, void **, u64, int, u64 *,
 				int, int);
@@ -58,6 +68,28 @@ extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
 extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64,
 				unsigned int);
 
+/* file.c */
+#ifdef CONFIG_SQUASHFS_PARALLEL_READAHEAD
+extern void squashfs_readahead_mount(struct super_block *);
+extern void squashfs_readahead_umount(struct super_block *);
+extern int squashfs_readahead_init(void);
+extern void squashfs_readahead_exit(void);
+#else
+static inline void squashfs_readahead_mount(struct super_block *sb)
+{
+}
+static inline void squashfs_readahead_umount(struct super_block *sb)
+{
+}
+static inline int squashfs_readahead_init(void)
+{
+	return 0;
+}
+static inline void squashfs_readahead_exit(void)
+{
+}
+#endif
+
 /* fragment.c */
 extern int squashfs_frag_lookup(struct super_block *, unsigned int, u64 *);
 extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
@@ -73,6 +105,12 @@ extern struct inode *squashfs_iget(struct super_block *, long long,
 				unsigned int);
 extern int squashfs_read_inode(struct inode *, long long);
 
+/* sysfs.c */
+extern int squashfs_sysfs_register(struct super_block *);
+extern void squashfs_sysfs_unregister(struct super_block *);
+extern int squashfs_sysfs_init(void);
+extern void squashfs_sysfs_exit(void);
+
 /* xattr.c */
 extern ssize_t squashfs_listxattr(struct dentry *, char *, size_t);
 
@@ -102,5 +140,11 @@ extern const struct inode_operations squashfs_symlink_inode_ops;
 /* xattr.c */
 extern const struct xattr_handler *squashfs_xattr_handlers[];
 
+/* lzma_wrapper.c */
+extern const struct squashfs_decompressor squashfs_lzma_comp_ops;
+
+/* lzo_wrapper.c */
+extern const struct squashfs_decompressor squashfs_lzo_comp_ops;
+
 /* zlib_wrapper.c */
 extern const struct squashfs_decompressor squashfs_zlib_comp_ops;
@@ -35,6 +35,7 @@ struct squashfs_inode_info {
 			int		fragment_size;
 			int		fragment_offset;
 			u64		block_list_start;
+			int		readahead_end;
 		};
 		struct {
 			u64		dir_idx_start;
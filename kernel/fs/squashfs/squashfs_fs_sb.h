@@ -36,6 +36,9 @@ struct squashfs_cache {
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		waits;
 };
 
 struct squashfs_cache_entry {
@@ -62,7 +65,6 @@ struct squashfs_sb_info {
 	__le64					*id_table;
 	__le64					*fragment_index;
 	__le64					*xattr_id_table;
-	struct mutex				read_data_mutex;
 	struct mutex				meta_index_mutex;
 	struct meta_index			*meta_index;
 	void					*stream;
@@ -75,5 +77,9 @@ struct squashfs_sb_info {
 	long long				bytes_used;
 	unsigned int				inodes;
 	int					xattr_ids;
+	unsigned int				readahead_blocks;
+	atomic_long_t				readahead_issued;
+	struct kobject				kobj;
+	struct completion			kobj_unregister;
 };
 #endif
@@ -37,6 +37,7 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/cleancache.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -105,7 +106,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -209,7 +209,11 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
+	/*
+	 * Allocate read_page block.  Datablocks are normally decompressed
+	 * straight into the page cache, this is only used when several
+	 * readers race for the same block, one entry is enough.
+	 */
 	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
@@ -277,17 +281,21 @@ allocate_xattr_table:
 			goto failed_mount;
 	}
 allocate_root:
+	err = squashfs_sysfs_register(sb);
+	if (err)
+		goto failed_mount;
+
 	root = new_inode(sb);
 	if (!root) {
 		err = -ENOMEM;
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 
 	err = squashfs_read_inode(root, root_inode);
 	if (err) {
 		make_bad_inode(root);
 		iput(root);
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 	insert_inode_hash(root);
 
@@ -296,13 +304,20 @@ allocate_root:
 		ERROR("Root inode create failed\n");
 		err = -ENOMEM;
 		iput(root);
-		goto failed_mount;
+		goto failed_sysfs;
 	}
 
+	squashfs_readahead_mount(sb);
+	squashfs_benchmark(sb, fragments);
+
+	cleancache_init_fs(sb);
+
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
 
+failed_sysfs:
+	squashfs_sysfs_unregister(sb);
 failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
@@ -352,12 +367,24 @@ static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 }
 
 
+/*
+ * Parallel readahead holds references to inodes, which have to be dropped
+ * before the superblock goes away
+ */
+static void squashfs_kill_sb(struct super_block *sb)
+{
+	squashfs_readahead_umount(sb);
+	kill_block_super(sb);
+}
+
+
 static void squashfs_put_super(struct super_block *sb)
 {
 	lock_kernel();
 
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		squashfs_sysfs_unregister(sb);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
@@ -418,22 +445,38 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_sysfs_init();
+	if (err)
+		goto failed_sysfs;
+
+	err = squashfs_readahead_init();
+	if (err)
+		goto failed_readahead;
+
 	err = register_filesystem(&squashfs_fs_type);
-	if (err) {
-		destroy_inodecache();
-		return err;
-	}
+	if (err)
+		goto failed_register;
 
 	printk(KERN_INFO "squashfs: version 4.0 (2009/01/31) "
 		"Phillip Lougher\n");
 
 	return 0;
+
+failed_register:
+	squashfs_readahead_exit();
+failed_readahead:
+	squashfs_sysfs_exit();
+failed_sysfs:
+	destroy_inodecache();
+	return err;
 }
 
 
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_readahead_exit();
+	squashfs_sysfs_exit();
 	destroy_inodecache();
 }
 
@@ -457,7 +500,7 @@ static struct file_system_type squashfs_fs_type = {
 	.owner = THIS_MODULE,
 	.name = "squashfs",
 	.get_sb = squashfs_get_sb,
-	.kill_sb = kill_block_super,
+	.kill_sb = squashfs_kill_sb,
 	.fs_flags = FS_REQUIRES_DEV
 };
 
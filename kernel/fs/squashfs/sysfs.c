@@ -0,0 +1,208 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * sysfs.c
+ */
+
+/*
+ * This file exports per filesystem statistics and tunables in
+ * /sys/fs/squashfs/<device>/.  For each of the metadata, fragment and data
+ * caches it counts lookups that found the block (hits), lookups that had
+ * to read and decompress it (misses), and lookups that slept, waiting for
+ * another process to finish decompressing the block or for a free cache
+ * entry (waits).  A hit can also be a wait.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/completion.h>
+#include <linux/kernel.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+#include "decompressor.h"
+
+static struct kset *squashfs_kset;
+
+struct squashfs_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct squashfs_sb_info *, char *);
+	ssize_t (*store)(struct squashfs_sb_info *, const char *, size_t);
+};
+
+#define SQUASHFS_ATTR(name, mode, show, store) \
+static struct squashfs_attr squashfs_attr_##name = \
+	__ATTR(name, mode, show, store)
+#define SQUASHFS_RO_ATTR(name) SQUASHFS_ATTR(name, 0444, name##_show, NULL)
+#define SQUASHFS_RW_ATTR(name) \
+	SQUASHFS_ATTR(name, 0644, name##_show, name##_store)
+#define ATTR_LIST(name) &squashfs_attr_##name.attr
+
+/* The fragment cache only exists if the filesystem has fragments */
+#define SQUASHFS_CACHE_ATTR(name, cache, stat)				\
+static ssize_t name##_##stat##_show(struct squashfs_sb_info *msblk,	\
+	char *buf)							\
+{									\
+	return sprintf(buf, "%lu\n",					\
+		msblk->cache ? msblk->cache->stat : 0);			\
+}									\
+SQUASHFS_RO_ATTR(name##_##stat)
+
+SQUASHFS_CACHE_ATTR(metadata, block_cache, hits);
+SQUASHFS_CACHE_ATTR(metadata, block_cache, misses);
+SQUASHFS_CACHE_ATTR(metadata, block_cache, waits);
+SQUASHFS_CACHE_ATTR(fragment, fragment_cache, hits);
+SQUASHFS_CACHE_ATTR(fragment, fragment_cache, misses);
+SQUASHFS_CACHE_ATTR(fragment, fragment_cache, waits);
+SQUASHFS_CACHE_ATTR(data, read_page, hits);
+SQUASHFS_CACHE_ATTR(data, read_page, misses);
+SQUASHFS_CACHE_ATTR(data, read_page, waits);
+
+static ssize_t decompressors_show(struct squashfs_sb_info *msblk, char *buf)
+{
+	return sprintf(buf, "%d\n", squashfs_max_decompressors());
+}
+SQUASHFS_RO_ATTR(decompressors);
+
+#ifdef CONFIG_SQUASHFS_PARALLEL_READAHEAD
+static ssize_t readahead_blocks_show(struct squashfs_sb_info *msblk,
+	char *buf)
+{
+	return sprintf(buf, "%u\n", msblk->readahead_blocks);
+}
+
+static ssize_t readahead_blocks_store(struct squashfs_sb_info *msblk,
+	const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val) || val > INT_MAX)
+		return -EINVAL;
+	msblk->readahead_blocks = val;
+	return count;
+}
+SQUASHFS_RW_ATTR(readahead_blocks);
+
+static ssize_t readahead_issued_show(struct squashfs_sb_info *msblk,
+	char *buf)
+{
+	return sprintf(buf, "%ld\n", atomic_long_read(&msblk->readahead_issued));
+}
+SQUASHFS_RO_ATTR(readahead_issued);
+#endif
+
+static struct attribute *squashfs_attrs[] = {
+	ATTR_LIST(metadata_hits),
+	ATTR_LIST(metadata_misses),
+	ATTR_LIST(metadata_waits),
+	ATTR_LIST(fragment_hits),
+	ATTR_LIST(fragment_misses),
+	ATTR_LIST(fragment_waits),
+	ATTR_LIST(data_hits),
+	ATTR_LIST(data_misses),
+	ATTR_LIST(data_waits),
+	ATTR_LIST(decompressors),
+#ifdef CONFIG_SQUASHFS_PARALLEL_READAHEAD
+	ATTR_LIST(readahead_blocks),
+	ATTR_LIST(readahead_issued),
+#endif
+	NULL,
+};
+
+static ssize_t squashfs_attr_show(struct kobject *kobj,
+			      struct attribute *attr, char *buf)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+					attr);
+
+	return a->show ? a->show(msblk, buf) : 0;
+}
+
+static ssize_t squashfs_attr_store(struct kobject *kobj,
+			       struct attribute *attr,
+			       const char *buf, size_t len)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+					attr);
+
+	return a->store ? a->store(msblk, buf, len) : 0;
+}
+
+static void squashfs_sb_release(struct kobject *kobj)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, kobj);
+	complete(&msblk->kobj_unregister);
+}
+
+static const struct sysfs_ops squashfs_attr_ops = {
+	.show	= squashfs_attr_show,
+	.store	= squashfs_attr_store,
+};
+
+static struct kobj_type squashfs_ktype = {
+	.default_attrs	= squashfs_attrs,
+	.sysfs_ops	= &squashfs_attr_ops,
+	.release	= squashfs_sb_release,
+};
+
+
+int squashfs_sysfs_register(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int err;
+
+	msblk->kobj.kset = squashfs_kset;
+	init_completion(&msblk->kobj_unregister);
+	err = kobject_init_and_add(&msblk->kobj, &squashfs_ktype, NULL, "%s",
+			sb->s_id);
+	if (err) {
+		ERROR("Failed to register %s in sysfs\n", sb->s_id);
+		squashfs_sysfs_unregister(sb);
+	}
+	return err;
+}
+
+
+void squashfs_sysfs_unregister(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	kobject_put(&msblk->kobj);
+	wait_for_completion(&msblk->kobj_unregister);
+}
+
+
+int __init squashfs_sysfs_init(void)
+{
+	squashfs_kset = kset_create_and_add("squashfs", NULL, fs_kobj);
+	return squashfs_kset ? 0 : -ENOMEM;
+}
+
+
+void squashfs_sysfs_exit(void)
+{
+	kset_unregister(squashfs_kset);
+}
@@ -74,6 +74,7 @@
 #include <linux/proc_fs.h>
 #include <linux/smp_lock.h>
 #include <linux/pagemap.h>
+#include <linux/cleancache.h>
 #include <linux/mtd/mtd.h>
 #include <linux/interrupt.h>
 #include <linux/string.h>
@@ -1011,6 +1012,14 @@ static int yaffs_readpage_nolock(struct file *f, struct page *pg)
 		PAGE_BUG(pg);
 #endif
 
+	/* Clean pages evicted earlier may still be held by cleancache */
+	if (cleancache_get_page(pg) == 0) {
+		SetPageUptodate(pg);
+		ClearPageError(pg);
+		T(YAFFS_TRACE_OS, (TSTR("yaffs_readpage_nolock cleancache hit\n")));
+		return 0;
+	}
+
 	pg_buf = kmap(pg);
 	/* FIXME: Can kmap fail? */
 
@@ -1126,6 +1135,9 @@ static int yaffs_writepage(struct page *page)
 	nWritten = yaffs_WriteDataToFile(obj, buffer,
 			page->index << PAGE_CACHE_SHIFT, nBytes, 0);
 
+	/* Any copy of this page kept by cleancache is now stale */
+	cleancache_flush_page(mapping, page);
+
 	yaffs_MarkSuperBlockDirty(dev);
 
 	T(YAFFS_TRACE_OS,
@@ -3079,6 +3091,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	}
 	sb->s_root = root;
 	sb->s_dirt = !dev->isCheckpointed;
+	cleancache_init_fs(sb);
 	T(YAFFS_TRACE_ALWAYS,
 		(TSTR("yaffs_read_super: isCheckpointed %d\n"),
 		dev->isCheckpointed));
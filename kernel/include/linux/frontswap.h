@@ -17,6 +17,7 @@ extern struct frontswap_ops
 	frontswap_register_ops(struct frontswap_ops *ops);
 extern void frontswap_shrink(unsigned long);
 extern unsigned long frontswap_curr_pages(void);
+extern int frontswap_writeback_page(unsigned, pgoff_t);
 
 extern void frontswap_init(unsigned type);
 extern int __frontswap_put_page(struct page *page);
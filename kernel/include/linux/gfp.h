@@ -313,6 +313,9 @@ extern struct page *alloc_page_vma(gfp_t gfp_mask,
 #endif
 #define alloc_page(gfp_mask) alloc_pages(gfp_mask, 0)
 
+extern unsigned long alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+					struct list_head *list);
+
 extern unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order);
 extern unsigned long get_zeroed_page(gfp_t gfp_mask);
 
@@ -337,6 +340,13 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp);
 void drain_all_pages(void);
 void drain_local_pages(void *dummy);
 
+#ifdef CONFIG_CMA
+/* Regions of MIGRATE_CMA pageblocks, see mm/page_alloc.c */
+extern int init_cma_range(unsigned long start_pfn, unsigned long end_pfn);
+extern int alloc_contig_range(unsigned long start, unsigned long end);
+extern void free_contig_range(unsigned long pfn, unsigned long nr_pages);
+#endif
+
 extern gfp_t gfp_allowed_mask;
 
 extern void set_gfp_allowed_mask(gfp_t mask);
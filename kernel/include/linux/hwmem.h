@@ -588,6 +588,11 @@ struct hwmem_allocator_api {
 	phys_addr_t (*get_alloc_paddr)(void *alloc);
 	void *(*get_alloc_kaddr)(void *instance, void *alloc);
 	size_t (*get_alloc_size)(void *alloc);
+	/*
+	 * Optional, applies the alloc's memory type to other kernel mappings
+	 * of it, e.g. the linear mapping of system RAM.
+	 */
+	void (*set_alloc_pgprot)(void *instance, void *alloc, pgprot_t pgprot);
 };
 
 struct hwmem_mem_type_struct {
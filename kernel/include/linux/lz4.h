@@ -0,0 +1,41 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ *  LZ4 Kernel Interface
+ *
+ *  Copyright (C) 2011-2012, Yann Collet.
+ *  BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+ *
+ *  The LZ4 block format is described at http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#define LZ4_HASH_LOG		12
+#define LZ4_MEM_COMPRESS	((1 << LZ4_HASH_LOG) * sizeof(u32))
+
+/* largest input lz4_compress() accepts */
+#define LZ4_MAX_INPUT_SIZE	0x7E000000
+
+#define lz4_worst_compress(x)	((x) + ((x) / 255) + 16)
+
+/* This requires 'wrkmem' of size LZ4_MEM_COMPRESS */
+int lz4_compress(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/* safe decompression with overrun testing */
+int lz4_decompress_safe(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+
+/*
+ * Return values (< 0 = Error)
+ */
+#define LZ4_E_OK		0
+#define LZ4_E_OUTPUT_OVERRUN	(-1)
+#define LZ4_E_INPUT_OVERRUN	(-2)
+#define LZ4_E_LOOKBEHIND_OVERRUN	(-3)
+#define LZ4_E_INPUT_TOO_LARGE	(-4)
+
+#endif
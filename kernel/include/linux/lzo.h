@@ -23,10 +23,20 @@
 int lzo1x_1_compress(const unsigned char *src, size_t src_len,
 			unsigned char *dst, size_t *dst_len, void *wrkmem);
 
-/* safe decompression with overrun testing */
+/*
+ * safe decompression with overrun testing
+ *
+ * Architectures with CONFIG_HAVE_ARCH_LZO1X_DECOMPRESS provide their own
+ * lzo1x_decompress_safe().  Like the portable version, it writes nothing
+ * past the decompressed length returned in 'dst_len'.
+ */
 int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
 			unsigned char *dst, size_t *dst_len);
 
+/* portable C version, always available */
+int lzo1x_decompress_safe_generic(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+
 /*
  * Return values (< 0 = Error)
  */
@@ -177,6 +177,10 @@ struct vm_area_struct {
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 	unsigned long vm_truncate_count;/* truncate_count or restart_addr */
 
+#ifdef CONFIG_KSM
+	unsigned short ksm_cold;	/* full ksm scans in a row with low yield */
+	unsigned short ksm_skip;	/* full ksm scans left to skip this vma */
+#endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -310,6 +314,11 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_KSM
+	unsigned long ksm_rmap_items;	/* pages tracked by ksmd */
+	unsigned long ksm_merging_pages;/* of those, merged into ksm pages */
+	unsigned long ksm_pages_scanned;/* pages scanned by ksmd so far */
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -14,6 +14,7 @@
 
 struct zonelist;
 struct notifier_block;
+struct task_struct;
 
 /*
  * Types of limitations to the nodes from which allocations may occur
@@ -32,6 +33,21 @@ extern void out_of_memory(struct zonelist *zonelist, gfp_t gfp_mask,
 extern int register_oom_notifier(struct notifier_block *nb);
 extern int unregister_oom_notifier(struct notifier_block *nb);
 
+/*
+ * Events of the oom_adj notifier chain, which lets a killer keep its own
+ * index of candidate processes; the data is a task of the thread group.
+ * Callbacks run in atomic context.
+ */
+enum oom_adj_event {
+	OOM_ADJ_FORK,		/* new thread group, not running yet */
+	OOM_ADJ_CHANGE,		/* /proc/<pid>/oom_adj was written */
+	OOM_ADJ_EXIT,		/* the last thread of the group released its mm */
+};
+
+extern int register_oom_adj_notifier(struct notifier_block *nb);
+extern int unregister_oom_adj_notifier(struct notifier_block *nb);
+extern void oom_adj_notify(unsigned long event, struct task_struct *p);
+
 extern bool oom_killer_disabled;
 
 static inline void oom_killer_disable(void)
@@ -637,6 +637,12 @@ struct signal_struct {
 #endif
 
 	int oom_adj;	/* OOM kill score adjustment (bit shift) */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	/* lowmemorykiller victim index: oom_adj bucket and cached rss */
+	struct list_head lmk_node;
+	int lmk_adj;
+	unsigned long lmk_rss;
+#endif
 };
 
 /* Context switch must be unlocked if interrupts are to be enabled */
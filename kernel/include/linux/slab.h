@@ -113,6 +113,36 @@ const char *kmem_cache_name(struct kmem_cache *);
 int kern_ptr_validate(const void *ptr, unsigned long size);
 int kmem_ptr_validate(struct kmem_cache *cachep, const void *ptr);
 
+/*
+ * Allocator independent fast and slow path counts, kept per cache and per
+ * cpu with CONFIG_SLAB_HOTPATH_STATS and shown in /proc/slabinfo.
+ */
+enum slab_hotpath_item {
+	SLAB_HOTPATH_ALLOC_FAST,	/* Allocation from the cpu's objects */
+	SLAB_HOTPATH_ALLOC_SLOW,	/* Allocation needing a refill */
+	SLAB_HOTPATH_FREE_FAST,		/* Free to the cpu's objects */
+	SLAB_HOTPATH_FREE_SLOW,		/* Free needing a flush or slab update */
+	SLAB_HOTPATH_FREE_REMOTE,	/* Free of an object from another node */
+	NR_SLAB_HOTPATH_ITEMS
+};
+
+struct seq_file;
+
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+void kmem_cache_hotpath_stats(struct kmem_cache *, unsigned long *);
+void slabinfo_hotpath_header(struct seq_file *m);
+void slabinfo_hotpath_show(struct seq_file *m, const unsigned long *hotpath);
+#else
+static inline void slabinfo_hotpath_header(struct seq_file *m)
+{
+}
+
+static inline void slabinfo_hotpath_show(struct seq_file *m,
+					 const unsigned long *hotpath)
+{
+}
+#endif
+
 /*
  * Please use this macro to create slab caches. Simply specify the
  * name of the structure and maybe some flags that are listed above.
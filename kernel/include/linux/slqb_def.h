@@ -113,6 +113,9 @@ struct kmem_cache_cpu {
 	struct kmlist		rlist;
 	struct kmem_cache_list	*remote_cache_list;
 #endif
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	unsigned long		hotpath[NR_SLAB_HOTPATH_ITEMS];
+#endif
 } ____cacheline_aligned_in_smp;
 
 /*
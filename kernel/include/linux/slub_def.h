@@ -41,6 +41,9 @@ struct kmem_cache_cpu {
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	unsigned long hotpath[NR_SLAB_HOTPATH_ITEMS];
+#endif
 };
 
 struct kmem_cache_node {
@@ -0,0 +1,29 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/gfp.h>
+
+struct notifier_block;
+
+/*
+ * Reclaim pressure is the share, in percent, of the pages scanned by
+ * page reclaim that could not be reclaimed, over a window of scanned
+ * pages. These are the thresholds of its medium and critical levels.
+ */
+#define VMPRESSURE_MEDIUM	60
+#define VMPRESSURE_CRITICAL	95
+
+#ifdef __KERNEL__
+
+/*
+ * The notifier chain is called at the end of each window, with the
+ * pressure as the event and in atomic context.
+ */
+extern int register_vmpressure_notifier(struct notifier_block *nb);
+extern int unregister_vmpressure_notifier(struct notifier_block *nb);
+
+extern void vmpressure(gfp_t gfp_mask, unsigned long scanned,
+		       unsigned long reclaimed);
+
+#endif /* __KERNEL__ */
+#endif /* __LINUX_VMPRESSURE_H */
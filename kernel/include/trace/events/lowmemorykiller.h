@@ -0,0 +1,52 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/*
+ * lowmem_select - a victim search of the low memory killer
+ * @min_adj: lowest oom_adj that may be killed at this memory level
+ * @p: the selected task, or NULL if no candidate was found
+ * @adj: oom_adj of @p
+ * @tasksize: rss of @p in pages
+ * @latency: time the search took in ns
+ */
+TRACE_EVENT(lowmem_select,
+
+	TP_PROTO(int min_adj, struct task_struct *p, int adj, int tasksize,
+		 u64 latency),
+
+	TP_ARGS(min_adj, p, adj, tasksize, latency),
+
+	TP_STRUCT__entry(
+		__field(	int,	min_adj		)
+		__field(	pid_t,	pid		)
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	int,	adj		)
+		__field(	int,	tasksize	)
+		__field(	u64,	latency		)
+	),
+
+	TP_fast_assign(
+		__entry->min_adj	= min_adj;
+		__entry->pid		= p ? p->pid : 0;
+		strncpy(__entry->comm, p ? p->comm : "", TASK_COMM_LEN);
+		__entry->adj		= adj;
+		__entry->tasksize	= tasksize;
+		__entry->latency	= latency;
+	),
+
+	TP_printk("min_adj=%d pid=%d comm=%s adj=%d tasksize=%d latency=%llu ns",
+		  __entry->min_adj, __entry->pid, __entry->comm,
+		  __entry->adj, __entry->tasksize,
+		  (unsigned long long)__entry->latency)
+);
+
+#endif /* _TRACE_LOWMEMORYKILLER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
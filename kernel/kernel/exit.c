@@ -25,6 +25,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/ptrace.h>
 #include <linux/profile.h>
+#include <linux/oom.h>
 #include <linux/mount.h>
 #include <linux/proc_fs.h>
 #include <linux/kthread.h>
@@ -962,8 +963,11 @@ NORET_TYPE void do_exit(long code)
 
 	exit_mm(tsk);
 
-	if (group_dead)
+	if (group_dead) {
+		/* after exit_mm(), so listeners see the memory released */
+		oom_adj_notify(OOM_ADJ_EXIT, tsk);
 		acct_process();
+	}
 	trace_sched_process_exit(tsk);
 
 	exit_sem(tsk);
@@ -48,6 +48,7 @@
 #include <linux/memcontrol.h>
 #include <linux/ftrace.h>
 #include <linux/profile.h>
+#include <linux/oom.h>
 #include <linux/rmap.h>
 #include <linux/ksm.h>
 #include <linux/acct.h>
@@ -504,6 +505,11 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	spin_lock_init(&mm->page_table_lock);
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
+#ifdef CONFIG_KSM
+	mm->ksm_rmap_items = 0;
+	mm->ksm_merging_pages = 0;
+	mm->ksm_pages_scanned = 0;
+#endif
 	mm_init_aio(mm);
 	mm_init_owner(mm, p);
 
@@ -921,6 +927,9 @@ static int copy_signal(unsigned long clone_flags, struct task_struct *tsk)
 	sched_autogroup_fork(sig);
 
 	sig->oom_adj = current->signal->oom_adj;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	INIT_LIST_HEAD(&sig->lmk_node);
+#endif
 
 	return 0;
 }
@@ -1306,6 +1315,8 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 	proc_fork_connector(p);
 	cgroup_post_fork(p);
 	perf_event_fork(p);
+	if (!(clone_flags & CLONE_THREAD))
+		oom_adj_notify(OOM_ADJ_FORK, p);
 	return p;
 
 bad_fork_free_pid:
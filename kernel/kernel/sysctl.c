@@ -267,6 +267,7 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compact_order = MAX_ORDER - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1156,6 +1157,15 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_proactive_order",
+		.data		= &sysctl_compact_proactive_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &max_compact_order,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -1181,6 +1191,13 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_fraction_sysctl_handler,
 		.extra1		= &min_percpu_pagelist_fract,
 	},
+	{
+		.procname	= "percpu_pagelist_zone_fraction",
+		.data		= &sysctl_percpu_pagelist_zone_fraction,
+		.maxlen		= sizeof(sysctl_percpu_pagelist_zone_fraction),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_zone_fraction_sysctl_handler,
+	},
 #ifdef CONFIG_MMU
 	{
 		.procname	= "max_map_count",
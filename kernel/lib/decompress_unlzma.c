@@ -34,6 +34,10 @@
 #else
 #include <linux/decompress/unlzma.h>
 #include <linux/slab.h>
+#ifdef CONFIG_DECOMPRESS_LZMA_RUNTIME
+#include <linux/module.h>
+#define INIT
+#endif
 #endif /* STATIC */
 
 #include <linux/decompress/mm.h>
@@ -387,7 +391,16 @@ static inline void INIT process_bit0(struct writer *wr, struct rc *rc,
 		cst->state -= 6;
 }
 
-static inline void INIT process_bit1(struct writer *wr, struct rc *rc,
+/*
+ * A match must not reach back before the start of the output or further
+ * than the dictionary, corrupt input would make us read outside the buffer.
+ */
+static inline int INIT match_ok(struct writer *wr, uint32_t rep0)
+{
+	return rep0 <= wr->header->dict_size && rep0 <= get_pos(wr);
+}
+
+static inline int INIT process_bit1(struct writer *wr, struct rc *rc,
 					    struct cstate *cst, uint16_t *p,
 					    int pos_state, uint16_t *prob) {
   int offset;
@@ -418,8 +431,10 @@ static inline void INIT process_bit1(struct writer *wr, struct rc *rc,
 
 				cst->state = cst->state < LZMA_NUM_LIT_STATES ?
 					9 : 11;
+				if (!match_ok(wr, cst->rep0))
+					return -1;
 				copy_byte(wr, cst->rep0);
-				return;
+				return 0;
 			} else {
 				rc_update_bit_1(rc, prob);
 			}
@@ -521,12 +536,16 @@ static inline void INIT process_bit1(struct writer *wr, struct rc *rc,
 		} else
 			cst->rep0 = pos_slot;
 		if (++(cst->rep0) == 0)
-			return;
+			return 0;
 	}
 
+	if (!match_ok(wr, cst->rep0))
+		return -1;
+
 	len += LZMA_MATCH_MIN_LEN;
 
 	copy_bytes(wr, cst->rep0, len);
+	return 0;
 }
 
 
@@ -631,7 +650,10 @@ STATIC inline int INIT unlzma(unsigned char *buf, int in_len,
 			process_bit0(&wr, &rc, &cst, p, pos_state, prob,
 				     lc, literal_pos_mask);
 		else {
-			process_bit1(&wr, &rc, &cst, p, pos_state, prob);
+			if (process_bit1(&wr, &rc, &cst, p, pos_state, prob)) {
+				error("corrupt data");
+				goto exit_3;
+			}
 			if (cst.rep0 == 0)
 				break;
 		}
@@ -642,6 +664,7 @@ STATIC inline int INIT unlzma(unsigned char *buf, int in_len,
 	if (wr.flush)
 		wr.flush(wr.buffer, wr.buffer_pos);
 	ret = 0;
+exit_3:
 	large_free(p);
 exit_2:
 	if (!output)
@@ -653,6 +676,10 @@ exit_0:
 	return ret;
 }
 
+#if defined(CONFIG_DECOMPRESS_LZMA_RUNTIME) && !defined(PREBOOT)
+EXPORT_SYMBOL(unlzma);
+#endif
+
 #ifdef PREBOOT
 STATIC int INIT decompress(unsigned char *buf, int in_len,
 			      int(*fill)(void*, unsigned int),
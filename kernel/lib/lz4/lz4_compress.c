@@ -0,0 +1,171 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  Copyright (C) 2011-2012, Yann Collet.
+ *  BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+ *
+ *  The LZ4 block format is described at http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_read32(const unsigned char *p)
+{
+	return get_unaligned((const u32 *)p);
+}
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (lz4_read32(p) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Output 'len' (already reduced by the 15 in the token) as 255s and rest */
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const unsigned char * const in_end = src + src_len;
+	const unsigned char * const mflimit = in_end - MFLIMIT;
+	const unsigned char * const matchlimit = in_end - LASTLITERALS;
+	unsigned char * const op_end = dst + *dst_len;
+	const unsigned char *ip = src, *anchor = src, *ref;
+	unsigned char *op = dst, *token;
+	u32 *table = wrkmem;
+	size_t len;
+
+	if (src_len > LZ4_MAX_INPUT_SIZE)
+		return LZ4_E_INPUT_TOO_LARGE;
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	memset(table, 0, LZ4_MEM_COMPRESS);
+	ip++;
+
+	for (;;) {
+		const unsigned char *next = ip;
+		unsigned int attempts = 1 << SKIP_STRENGTH;
+		unsigned int step = 1;
+		u32 h;
+
+		/*
+		 * Find a match; table entries are offsets from 'src', so
+		 * the zeroed table points every hash at the first byte.
+		 * Each miss after the first 1 << SKIP_STRENGTH lengthens
+		 * the step, so incompressible data is skipped quickly.
+		 */
+		do {
+			ip = next;
+			next += step;
+			step = attempts++ >> SKIP_STRENGTH;
+			if (unlikely(next > mflimit))
+				goto last_literals;
+
+			h = lz4_hash(ip);
+			ref = src + table[h];
+			table[h] = ip - src;
+		} while (ref + MAX_DISTANCE < ip ||
+			 lz4_read32(ref) != lz4_read32(ip));
+
+		/* Extend the match backwards into the pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		len = ip - anchor;
+		if (unlikely((size_t)(op_end - op) <
+			     1 + len + len / 255 + 1 + 2))
+			return LZ4_E_OUTPUT_OVERRUN;
+
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else {
+			*token = len << ML_BITS;
+		}
+		memcpy(op, anchor, len);
+		op += len;
+
+next_match:
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		len = ip - anchor;
+		if (unlikely((size_t)(op_end - op) < len / 255 + 1))
+			return LZ4_E_OUTPUT_OVERRUN;
+		if (len >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token |= len;
+		}
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		table[lz4_hash(ip - 2)] = ip - 2 - src;
+
+		/* A match right away needs no literals */
+		h = lz4_hash(ip);
+		ref = src + table[h];
+		table[h] = ip - src;
+		if (ref + MAX_DISTANCE >= ip &&
+		    lz4_read32(ref) == lz4_read32(ip)) {
+			if (unlikely((size_t)(op_end - op) < 1 + 2))
+				return LZ4_E_OUTPUT_OVERRUN;
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		ip++;
+	}
+
+last_literals:
+	len = in_end - anchor;
+	if (unlikely((size_t)(op_end - op) < 1 + len + len / 255 + 1))
+		return LZ4_E_OUTPUT_OVERRUN;
+
+	if (len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*op++ = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
@@ -0,0 +1,164 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Copyright (C) 2011-2012, Yann Collet.
+ *  BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+ *
+ *  The LZ4 block format is described at http://code.google.com/p/lz4/
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+/*
+ * Read the extension of a length nibble that was 15. Returns false if
+ * the input ends before the final byte below 255.
+ */
+static inline bool lz4_get_length(const unsigned char **ipp,
+			const unsigned char *ip_end, size_t *len)
+{
+	const unsigned char *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (unlikely(ip >= ip_end))
+			return false;
+		s = *ip++;
+		*len += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return true;
+}
+
+static inline void lz4_copy8(unsigned char *dst, const unsigned char *src)
+{
+	put_unaligned(get_unaligned((const u64 *)src), (u64 *)dst);
+}
+
+/*
+ * Copy 'len' bytes in steps of 8, storing up to 7 bytes past the end;
+ * 'src' must be at least 8 bytes behind 'dst' if it precedes it.
+ */
+static inline void lz4_wild_copy(unsigned char *dst, const unsigned char *src,
+			size_t len)
+{
+	unsigned char * const end = dst + len;
+
+	do {
+		lz4_copy8(dst, src);
+		dst += 8;
+		src += 8;
+	} while (dst < end);
+}
+
+int lz4_decompress_safe(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len)
+{
+	const unsigned char * const ip_end = src + src_len;
+	unsigned char * const op_end = dst + *dst_len;
+	const unsigned char *ip = src, *ref;
+	unsigned char *op = dst;
+	size_t len, offset;
+	unsigned int token;
+	int ret;
+
+	if (unlikely(!src_len)) {
+		ret = LZ4_E_INPUT_OVERRUN;
+		goto out;
+	}
+
+	for (;;) {
+		token = *ip++;
+
+		/* literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && !lz4_get_length(&ip, ip_end, &len))
+			goto input_overrun;
+		if (unlikely(len > (size_t)(ip_end - ip)))
+			goto input_overrun;
+		if (unlikely(len > (size_t)(op_end - op)))
+			goto output_overrun;
+		if (len + 8 <= (size_t)(op_end - op) &&
+		    len + 8 <= (size_t)(ip_end - ip))
+			lz4_wild_copy(op, ip, len);
+		else
+			memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* the last sequence has no match */
+		if (ip == ip_end)
+			break;
+
+		/* match */
+		if (unlikely(ip_end - ip < 2))
+			goto input_overrun;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(!offset || offset > (size_t)(op - dst))) {
+			ret = LZ4_E_LOOKBEHIND_OVERRUN;
+			goto out;
+		}
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && !lz4_get_length(&ip, ip_end, &len))
+			goto input_overrun;
+		len += MINMATCH;
+		if (unlikely(len > (size_t)(op_end - op)))
+			goto output_overrun;
+
+		if (len + 8 > (size_t)(op_end - op)) {
+			/* near the end of the output: no room to overshoot */
+			while (len--)
+				*op++ = *ref++;
+		} else {
+			if (offset < 8) {
+				/*
+				 * Extend the 'offset' byte pattern until a
+				 * whole number of its periods spans 8 bytes,
+				 * then copy from that many bytes behind.
+				 */
+				size_t period = offset * ((8 + offset - 1) / offset);
+				size_t n = min(period - offset, len);
+
+				len -= n;
+				while (n--)
+					*op++ = *ref++;
+				ref = op - period;
+			}
+			if (len)
+				lz4_wild_copy(op, ref, len);
+			op += len;
+		}
+
+		if (unlikely(ip >= ip_end))
+			goto input_overrun;
+	}
+
+	ret = LZ4_E_OK;
+	goto out;
+
+input_overrun:
+	ret = LZ4_E_INPUT_OVERRUN;
+	goto out;
+
+output_overrun:
+	ret = LZ4_E_OUTPUT_OVERRUN;
+out:
+	*dst_len = op - dst;
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lz4_decompress_safe);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
@@ -0,0 +1,36 @@
+/*
+ *  lz4defs.h -- LZ4 block format constants
+ *
+ *  Copyright (C) 2011-2012, Yann Collet.
+ *  BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * A block is a series of sequences: a token byte, whose high nibble is
+ * the literal run length and low nibble the match length minus MINMATCH,
+ * each nibble extended by bytes of 255 up to a final byte < 255 when it
+ * is 15; the literals; the 16-bit little endian match offset; then the
+ * match length extension. The last sequence stops after its literals.
+ */
+#define MINMATCH	4
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	0xffff
+
+/*
+ * The last LASTLITERALS bytes of a block are always literals, and the
+ * last match starts at least MFLIMIT bytes before its end.
+ */
+#define LASTLITERALS	5
+#define MFLIMIT		(8 + MINMATCH)
+
+/* bytes from which the compressor gets sparser in its match search */
+#define SKIP_STRENGTH	6
@@ -27,7 +27,12 @@
 #define COPY4(dst, src)	\
 		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
 
-int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+/* The pre-boot decompressors only ever use the generic version */
+#ifdef STATIC
+#define lzo1x_decompress_safe_generic lzo1x_decompress_safe
+#endif
+
+int lzo1x_decompress_safe_generic(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
 {
 	const unsigned char * const ip_end = in + in_len;
@@ -247,7 +252,16 @@ lookbehind_overrun:
 	return LZO_E_LOOKBEHIND_OVERRUN;
 }
 #ifndef STATIC
+EXPORT_SYMBOL_GPL(lzo1x_decompress_safe_generic);
+
+#ifndef CONFIG_HAVE_ARCH_LZO1X_DECOMPRESS
+int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+			unsigned char *out, size_t *out_len)
+{
+	return lzo1x_decompress_safe_generic(in, in_len, out, out_len);
+}
 EXPORT_SYMBOL_GPL(lzo1x_decompress_safe);
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("LZO1X Decompressor");
@@ -0,0 +1,250 @@
+/*
+ * Cross-check lzo1x_decompress_safe() against the portable
+ * lzo1x_decompress_safe_generic(), for architectures providing their
+ * own version (CONFIG_HAVE_ARCH_LZO1X_DECOMPRESS).
+ *
+ * A corpus of generated buffers (zeros, short repeating patterns, text,
+ * random bytes and a mix of those) is compressed with lzo1x_1_compress()
+ * and decompressed by both versions at all input/output alignments,
+ * from intact, truncated and corrupted streams, and into buffers with
+ * and without room to spare. Both must return the same result, output
+ * length and data, and must not write past the output length. The time
+ * both take to decompress a page of each corpus is reported as well.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/hrtimer.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#define TEST_MAX_LEN	(4 * PAGE_SIZE)
+#define TEST_GUARD	64
+#define TEST_ROUNDS	2000
+#define TEST_TIMINGS	1000
+
+enum {
+	CORPUS_ZERO,
+	CORPUS_PATTERN,
+	CORPUS_TEXT,
+	CORPUS_RANDOM,
+	CORPUS_MIXED,
+	NR_CORPUS,
+};
+
+static const char * const corpus_names[] __initconst = {
+	"zero", "pattern", "text", "random", "mixed",
+};
+
+struct test_bufs {
+	unsigned char src[TEST_MAX_LEN];
+	unsigned char comp[lzo1x_worst_compress(TEST_MAX_LEN)];
+	unsigned char in[lzo1x_worst_compress(TEST_MAX_LEN) + 4];
+	unsigned char out1[TEST_MAX_LEN + 4 + TEST_GUARD];
+	unsigned char out2[TEST_MAX_LEN + 4 + TEST_GUARD];
+	unsigned char wrkmem[LZO1X_1_MEM_COMPRESS];
+};
+
+static u32 test_seed __initdata = 1;
+
+static u32 __init test_rand(void)
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return test_seed >> 16;
+}
+
+static void __init fill_corpus(unsigned char *buf, size_t len, int kind)
+{
+	static const char * const words[] __initconst = {
+		"the ", "zram ", "swap ", "page ", "kernel ", "\n",
+		"0x00000000 ", "struct ", "{\n\t", "return ", "lzo ",
+	};
+	size_t i, period, run;
+	const char *w;
+	int mode;
+
+	switch (kind) {
+	case CORPUS_ZERO:
+		memset(buf, 0, len);
+		break;
+	case CORPUS_PATTERN:
+		period = 1 + test_rand() % 24;
+		for (i = 0; i < len; i++)
+			buf[i] = i < period ? test_rand() : buf[i - period];
+		break;
+	case CORPUS_TEXT:
+		for (i = 0; i < len; ) {
+			w = words[test_rand() % ARRAY_SIZE(words)];
+			while (*w && i < len)
+				buf[i++] = *w++;
+		}
+		break;
+	case CORPUS_RANDOM:
+		for (i = 0; i < len; i++)
+			buf[i] = test_rand();
+		break;
+	default:
+		for (i = 0; i < len; ) {
+			run = 1 + test_rand() % 300;
+			mode = test_rand() % 3;
+			for (; run && i < len; run--, i++) {
+				if (mode == 0)
+					buf[i] = test_rand();
+				else if (mode == 1)
+					buf[i] = 0;
+				else
+					buf[i] = i >= 37 ? buf[i - 37] : 'x';
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Decompress 'in_len' bytes of b->comp (copied to offset 'in_off') with
+ * both versions, into 'cap' bytes at offset 'out_off'. Returns 0 if they
+ * agree, and if 'expect' is set, produced b->src[0..len).
+ */
+static int __init test_one(struct test_bufs *b, size_t len, size_t in_len,
+			   int in_off, int out_off, size_t cap, bool expect)
+{
+	size_t len1 = cap, len2 = cap, i;
+	int ret1, ret2;
+
+	memcpy(b->in + in_off, b->comp, in_len);
+	memset(b->out1, 0xa5, sizeof(b->out1));
+	memset(b->out2, 0xa5, sizeof(b->out2));
+
+	ret1 = lzo1x_decompress_safe_generic(b->in + in_off, in_len,
+					     b->out1 + out_off, &len1);
+	ret2 = lzo1x_decompress_safe(b->in + in_off, in_len,
+				     b->out2 + out_off, &len2);
+
+	if (ret1 != ret2 || len1 != len2 ||
+	    memcmp(b->out1 + out_off, b->out2 + out_off, len1)) {
+		pr_err("test_lzo1x: mismatch: len %zu in_len %zu cap %zu: "
+			"ret %d/%d out_len %zu/%zu\n",
+			len, in_len, cap, ret1, ret2, len1, len2);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < sizeof(b->out2); i++) {
+		if (i >= out_off && i < out_off + len2)
+			continue;
+		if (b->out2[i] != 0xa5) {
+			pr_err("test_lzo1x: write outside of output: "
+				"len %zu cap %zu at %zd\n",
+				len, cap, (ssize_t)i - out_off);
+			return -EINVAL;
+		}
+	}
+
+	if (expect && (ret1 != LZO_E_OK || len1 != len ||
+		       memcmp(b->out1 + out_off, b->src, len))) {
+		pr_err("test_lzo1x: bad decompression: len %zu ret %d\n",
+			len, ret1);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int __init test_round(struct test_bufs *b, int round)
+{
+	size_t len, clen = sizeof(b->comp), cap;
+	int kind, in_off, out_off, err = 0;
+
+	if (round % 5 == 0)
+		len = PAGE_SIZE;
+	else
+		len = 1 + test_rand() % (round % 3 ? 300 : TEST_MAX_LEN);
+	kind = test_rand() % NR_CORPUS;
+	fill_corpus(b->src, len, kind);
+
+	if (lzo1x_1_compress(b->src, len, b->comp, &clen, b->wrkmem)) {
+		pr_err("test_lzo1x: compression failed\n");
+		return -EINVAL;
+	}
+
+	for (in_off = 0; in_off < 4; in_off++) {
+		for (out_off = 0; out_off < 4; out_off++) {
+			/* exact fit, and with room to spare */
+			err |= test_one(b, len, clen, in_off, out_off, len,
+					true);
+			err |= test_one(b, len, clen, in_off, out_off,
+					len + test_rand() % TEST_GUARD, true);
+		}
+	}
+
+	/* truncated stream */
+	err |= test_one(b, len, 1 + test_rand() % clen, 0, 0, len, false);
+
+	/* output buffer too small */
+	cap = test_rand() % len;
+	err |= test_one(b, len, clen, 0, 0, cap, false);
+
+	/* corrupted stream */
+	b->comp[test_rand() % clen] ^= 1 << (test_rand() % 8);
+	err |= test_one(b, len, clen, 1, 3, len, false);
+
+	return err;
+}
+
+static void __init test_timing(struct test_bufs *b, int kind)
+{
+	size_t clen = sizeof(b->comp), len;
+	ktime_t start;
+	s64 ns1, ns2;
+	int i;
+
+	fill_corpus(b->src, PAGE_SIZE, kind);
+	lzo1x_1_compress(b->src, PAGE_SIZE, b->comp, &clen, b->wrkmem);
+
+	start = ktime_get();
+	for (i = 0; i < TEST_TIMINGS; i++) {
+		len = PAGE_SIZE;
+		lzo1x_decompress_safe_generic(b->comp, clen, b->out1, &len);
+	}
+	ns1 = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (i = 0; i < TEST_TIMINGS; i++) {
+		len = PAGE_SIZE;
+		lzo1x_decompress_safe(b->comp, clen, b->out2, &len);
+	}
+	ns2 = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	pr_info("test_lzo1x: %-8s %4zu -> %4lu bytes: generic %lld ns, "
+		"lzo1x_decompress_safe %lld ns per page\n",
+		corpus_names[kind], clen, PAGE_SIZE,
+		div_s64(ns1, TEST_TIMINGS), div_s64(ns2, TEST_TIMINGS));
+}
+
+static int __init test_lzo1x_init(void)
+{
+	struct test_bufs *b;
+	int i, failed = 0;
+
+	b = vmalloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+
+	for (i = 0; i < TEST_ROUNDS; i++) {
+		if (test_round(b, i))
+			failed++;
+	}
+	pr_info("test_lzo1x: %d of %d rounds failed\n", failed, TEST_ROUNDS);
+
+	for (i = 0; i < NR_CORPUS; i++)
+		test_timing(b, i);
+
+	vfree(b);
+
+	/* Nothing to keep loaded */
+	return failed ? -EINVAL : -EAGAIN;
+}
+module_init(test_lzo1x_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,340 @@
+/*
+ * Slab allocator microbenchmark.
+ *
+ * For each object size, a cache is created and one thread per online cpu
+ * runs the same allocation pattern at the same time:
+ *
+ *  same-cpu:	allocate 'batch' objects and free them again, on the cpu
+ *		that allocated them, until 'count' objects were allocated
+ *  cross-cpu:	allocate 'count' objects, then free those allocated by the
+ *		next cpu
+ *  bulk:	allocate 'count' objects, then free them all
+ *
+ * The average time of kmem_cache_alloc() and kmem_cache_free() is reported
+ * for each test. With CONFIG_SLAB_HOTPATH_STATS, so is the share of
+ * allocations and frees that left the allocator's per-cpu fast paths, and
+ * the number of frees to another node: these are what usually costs cache
+ * misses. Setting 'touch' writes the first cache line of every object after
+ * allocating it, as a user of the object would, which charges the misses on
+ * objects coming from other cpus to the allocation time.
+ *
+ * Parameters: sizes=<size,...> count=<objects per cpu> batch=<objects>
+ * tests=<mask: 1 same-cpu, 2 cross-cpu, 4 bulk> touch=<0|1>
+ *
+ * SLUB may merge the test cache with a kmalloc cache of the same size, in
+ * which case other users of that cache add to the counts.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+static unsigned int sizes[8] = { 32, 128, 512, 2048 };
+static unsigned int nr_sizes = 4;
+module_param_array(sizes, uint, &nr_sizes, 0);
+
+static unsigned int count = 10000;
+module_param(count, uint, 0);
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0);
+
+static unsigned int tests = 7;
+module_param(tests, uint, 0);
+
+static bool touch;
+module_param(touch, bool, 0);
+
+enum {
+	BENCH_SAME_CPU,
+	BENCH_CROSS_CPU,
+	BENCH_BULK,
+	NR_BENCH,
+};
+
+static const char * const bench_names[] __initconst = {
+	"same-cpu", "cross-cpu", "bulk",
+};
+
+struct slab_bench;
+
+struct bench_cpu {
+	struct slab_bench *bench;
+	struct task_struct *task;
+	void **objs;
+	u64 alloc_ns;
+	u64 free_ns;
+	unsigned long failed;
+};
+
+struct slab_bench {
+	struct kmem_cache *cache;
+	unsigned int size;
+	int test;
+	int nr_threads;
+	atomic_t waiting;
+	unsigned int phase;
+	wait_queue_head_t wq;
+	atomic_t running;
+	struct completion done;
+	struct bench_cpu *cpus;
+};
+
+static u64 bench_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+/* Wait until all threads got here */
+static void bench_barrier(struct slab_bench *b)
+{
+	unsigned int phase = ACCESS_ONCE(b->phase);
+
+	if (atomic_dec_and_test(&b->waiting)) {
+		atomic_set(&b->waiting, b->nr_threads);
+		smp_wmb();
+		b->phase = phase + 1;
+		wake_up_all(&b->wq);
+	} else {
+		wait_event(b->wq, ACCESS_ONCE(b->phase) != phase);
+	}
+}
+
+static void bench_alloc(struct bench_cpu *bc, void **objs, unsigned int n)
+{
+	struct slab_bench *b = bc->bench;
+	size_t len = min_t(size_t, b->size, L1_CACHE_BYTES);
+	u64 start = bench_now();
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		objs[i] = kmem_cache_alloc(b->cache, GFP_KERNEL);
+		if (unlikely(!objs[i]))
+			bc->failed++;
+		else if (touch)
+			memset(objs[i], 0x5a, len);
+	}
+	bc->alloc_ns += bench_now() - start;
+}
+
+static void bench_free(struct bench_cpu *bc, void **objs, unsigned int n)
+{
+	struct slab_bench *b = bc->bench;
+	u64 start = bench_now();
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		if (likely(objs[i]))
+			kmem_cache_free(b->cache, objs[i]);
+	}
+	bc->free_ns += bench_now() - start;
+}
+
+static int bench_thread(void *data)
+{
+	struct bench_cpu *bc = data;
+	struct slab_bench *b = bc->bench;
+	struct bench_cpu *next;
+	unsigned int i, n;
+
+	bench_barrier(b);
+
+	switch (b->test) {
+	case BENCH_SAME_CPU:
+		for (i = 0; i < count; i += n) {
+			n = min(batch, count - i);
+			bench_alloc(bc, bc->objs, n);
+			bench_free(bc, bc->objs, n);
+		}
+		break;
+	case BENCH_CROSS_CPU:
+		bench_alloc(bc, bc->objs, count);
+		bench_barrier(b);
+		next = &b->cpus[(bc - b->cpus + 1) % b->nr_threads];
+		bench_free(bc, next->objs, count);
+		break;
+	case BENCH_BULK:
+		bench_alloc(bc, bc->objs, count);
+		bench_free(bc, bc->objs, count);
+		break;
+	}
+
+	if (atomic_dec_and_test(&b->running))
+		complete(&b->done);
+
+	/* kthread_stop() collects us */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+static unsigned long __init per_mille(unsigned long part, unsigned long other)
+{
+	if (!part)
+		return 0;
+	return div_u64((u64)part * 1000, part + other);
+}
+#endif
+
+static void __init bench_report(struct slab_bench *b, unsigned long *before,
+				unsigned long *after)
+{
+	u64 alloc_ns = 0, free_ns = 0;
+	unsigned long failed = 0, ops;
+	int i;
+
+	for (i = 0; i < b->nr_threads; i++) {
+		alloc_ns += b->cpus[i].alloc_ns;
+		free_ns += b->cpus[i].free_ns;
+		failed += b->cpus[i].failed;
+	}
+	ops = (unsigned long)count * b->nr_threads - failed;
+	if (!ops)
+		ops = 1;
+
+	pr_info("test_slab: %-9s %5u bytes: alloc %4llu ns, free %4llu ns"
+		" per object, %lu failed\n", bench_names[b->test], b->size,
+		div_u64(alloc_ns, ops), div_u64(free_ns, ops), failed);
+
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	for (i = 0; i < NR_SLAB_HOTPATH_ITEMS; i++)
+		after[i] -= before[i];
+	{
+		unsigned long alloc_slow = per_mille(
+				after[SLAB_HOTPATH_ALLOC_SLOW],
+				after[SLAB_HOTPATH_ALLOC_FAST]);
+		unsigned long free_slow = per_mille(
+				after[SLAB_HOTPATH_FREE_SLOW] +
+				after[SLAB_HOTPATH_FREE_REMOTE],
+				after[SLAB_HOTPATH_FREE_FAST]);
+
+		pr_info("test_slab: %-9s %5u bytes: alloc slowpath %lu.%lu%%,"
+			" free slowpath %lu.%lu%%, %lu remote frees\n",
+			bench_names[b->test], b->size,
+			alloc_slow / 10, alloc_slow % 10,
+			free_slow / 10, free_slow % 10,
+			after[SLAB_HOTPATH_FREE_REMOTE]);
+	}
+#endif
+}
+
+static int __init bench_run(struct slab_bench *b, int test)
+{
+	unsigned long before[NR_SLAB_HOTPATH_ITEMS] = { 0 };
+	unsigned long after[NR_SLAB_HOTPATH_ITEMS] = { 0 };
+	struct bench_cpu *bc;
+	int cpu, i = 0;
+
+	b->test = test;
+	b->phase = 0;
+	atomic_set(&b->waiting, b->nr_threads);
+	atomic_set(&b->running, b->nr_threads);
+	init_completion(&b->done);
+
+	for_each_online_cpu(cpu) {
+		bc = &b->cpus[i++];
+		bc->alloc_ns = 0;
+		bc->free_ns = 0;
+		bc->failed = 0;
+		bc->task = kthread_create(bench_thread, bc, "test_slab/%d",
+					  cpu);
+		if (IS_ERR(bc->task)) {
+			int err = PTR_ERR(bc->task);
+
+			while (--i > 0)
+				kthread_stop(b->cpus[i - 1].task);
+			return err;
+		}
+		kthread_bind(bc->task, cpu);
+	}
+
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	kmem_cache_hotpath_stats(b->cache, before);
+#endif
+	for (i = 0; i < b->nr_threads; i++)
+		wake_up_process(b->cpus[i].task);
+	/*
+	 * A thread stopped before it first ran would never get to the
+	 * barrier and leave the others waiting there: let all finish.
+	 */
+	wait_for_completion(&b->done);
+	for (i = 0; i < b->nr_threads; i++)
+		kthread_stop(b->cpus[i].task);
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	kmem_cache_hotpath_stats(b->cache, after);
+#endif
+
+	bench_report(b, before, after);
+	return 0;
+}
+
+static int __init test_slab_init(void)
+{
+	struct slab_bench b;
+	int i, test, err = 0;
+
+	if (!count || !batch)
+		return -EINVAL;
+
+	init_waitqueue_head(&b.wq);
+
+	get_online_cpus();
+	b.nr_threads = num_online_cpus();
+	b.cpus = kcalloc(b.nr_threads, sizeof(*b.cpus), GFP_KERNEL);
+	if (!b.cpus) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < b.nr_threads; i++) {
+		b.cpus[i].bench = &b;
+		b.cpus[i].objs = vmalloc(count * sizeof(void *));
+		if (!b.cpus[i].objs) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	for (i = 0; i < nr_sizes && !err; i++) {
+		b.size = sizes[i];
+		b.cache = kmem_cache_create("test_slab", b.size, 0, 0, NULL);
+		if (!b.cache) {
+			err = -ENOMEM;
+			break;
+		}
+
+		for (test = 0; test < NR_BENCH && !err; test++) {
+			if (!(tests & (1 << test)))
+				continue;
+			if (test == BENCH_CROSS_CPU && b.nr_threads < 2)
+				continue;
+			err = bench_run(&b, test);
+		}
+		kmem_cache_destroy(b.cache);
+	}
+
+out_free:
+	for (i = 0; i < b.nr_threads; i++)
+		vfree(b.cpus[i].objs);
+	kfree(b.cpus);
+out:
+	put_online_cpus();
+
+	/* Nothing to keep loaded */
+	return err ? err : -EAGAIN;
+}
+module_init(test_slab_init);
+MODULE_LICENSE("GPL");
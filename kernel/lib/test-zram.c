@@ -0,0 +1,365 @@
+/*
+ * zram swap-out and swap-in microbenchmark, on the block device given by
+ * 'path':
+ *
+ *  write:	for 1 up to the number of online cpus, one thread per cpu
+ *		writes 'writes' pages, one page per bio as swap-out does, to
+ *		its own part of the device. The total pages/s shows whether
+ *		compression scales with the number of cpus.
+ *  read:	swap readahead reads a cluster of pages around each fault.
+ *		'count' clusters of the largest size are written, then read
+ *		back as clusters of each size, with as few bios per cluster
+ *		as the queue allows, and the average and worst time per
+ *		cluster is reported. Run it with the device's 'async_reads'
+ *		set to 0 and to 1 to compare synchronous reads with reads
+ *		decompressed on all cpus.
+ *
+ * The device is opened exclusively and its contents are overwritten, so it
+ * must not be in use, e.g. as swap.
+ *
+ * Parameters: path=<block device> tests=<mask: 1 write, 2 read>
+ * writes=<pages per thread> clusters=<pages,...> count=<clusters>
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+static char *path;
+module_param(path, charp, 0);
+
+static unsigned int tests = 3;
+module_param(tests, uint, 0);
+
+static unsigned int writes = 4096;
+module_param(writes, uint, 0);
+
+static unsigned int clusters[8] = { 8, 16, 32 };
+static unsigned int nr_clusters = 3;
+module_param_array(clusters, uint, &nr_clusters, 0);
+
+static unsigned int count = 256;
+module_param(count, uint, 0);
+
+struct zram_bench_io {
+	atomic_t pending;
+	int error;
+	struct completion done;
+};
+
+static u64 bench_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static void bench_end_io(struct bio *bio, int error)
+{
+	struct zram_bench_io *io = bio->bi_private;
+
+	if (error)
+		io->error = error;
+	bio_put(bio);
+	if (atomic_dec_and_test(&io->pending))
+		complete(&io->done);
+}
+
+/*
+ * Read or write nr pages, starting at page index, and wait for them. The
+ * pages go into as few bios as the queue limits allow.
+ */
+static int bench_rw(struct block_device *bdev, int rw, struct page **pages,
+		    unsigned int nr, pgoff_t index)
+{
+	struct zram_bench_io io;
+	struct bio *bio;
+	unsigned int i = 0;
+
+	atomic_set(&io.pending, 1);
+	io.error = 0;
+	init_completion(&io.done);
+
+	while (i < nr) {
+		bio = bio_alloc(GFP_KERNEL, nr - i);
+		bio->bi_bdev = bdev;
+		bio->bi_sector = (sector_t)(index + i) << (PAGE_SHIFT - 9);
+		bio->bi_end_io = bench_end_io;
+		bio->bi_private = &io;
+		while (i < nr && bio_add_page(bio, pages[i], PAGE_SIZE, 0))
+			i++;
+		if (!bio->bi_size) {
+			bio_put(bio);
+			io.error = -EIO;
+			break;
+		}
+		atomic_inc(&io.pending);
+		submit_bio(rw, bio);
+	}
+
+	if (atomic_dec_and_test(&io.pending))
+		complete(&io.done);
+	wait_for_completion(&io.done);
+	return io.error;
+}
+
+/* Compressible, but neither zero filled nor the same as any other page */
+static void bench_fill(struct page *page, pgoff_t index)
+{
+	char *p = kmap(page);
+	unsigned int i;
+
+	for (i = 0; i < PAGE_SIZE; i += 32)
+		snprintf(p + i, 32, "zram page %08lx offset %04x\n",
+			 index, i);
+	kunmap(page);
+}
+
+struct zram_bench_writer {
+	struct task_struct *task;
+	struct block_device *bdev;
+	struct page *page;
+	pgoff_t index;
+	int error;
+	struct completion *start;
+	atomic_t *running;
+	struct completion *done;
+};
+
+static int bench_write_thread(void *data)
+{
+	struct zram_bench_writer *w = data;
+	unsigned int i;
+	char *p;
+
+	wait_for_completion(w->start);
+
+	for (i = 0; i < writes && !w->error; i++) {
+		/* Don't let deduplication store it only once */
+		p = kmap(w->page);
+		snprintf(p, 32, "zram page %08lx offset %04x\n",
+			 w->index + i, 0);
+		kunmap(w->page);
+		w->error = bench_rw(w->bdev, WRITE, &w->page, 1,
+				    w->index + i);
+	}
+
+	if (atomic_dec_and_test(w->running))
+		complete(w->done);
+
+	/* kthread_stop() collects us */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int __init bench_write_run(struct zram_bench_writer *w,
+				  int nr_threads)
+{
+	DECLARE_COMPLETION_ONSTACK(start);
+	DECLARE_COMPLETION_ONSTACK(done);
+	atomic_t running;
+	u64 ns;
+	int cpu, i = 0, err = 0;
+
+	atomic_set(&running, nr_threads);
+	for_each_online_cpu(cpu) {
+		if (i == nr_threads)
+			break;
+		w[i].error = 0;
+		w[i].start = &start;
+		w[i].running = &running;
+		w[i].done = &done;
+		w[i].task = kthread_create(bench_write_thread, &w[i],
+					   "test_zram/%d", cpu);
+		if (IS_ERR(w[i].task)) {
+			err = PTR_ERR(w[i].task);
+			while (--i >= 0)
+				kthread_stop(w[i].task);
+			return err;
+		}
+		kthread_bind(w[i].task, cpu);
+		i++;
+	}
+
+	for (i = 0; i < nr_threads; i++)
+		wake_up_process(w[i].task);
+	ns = bench_now();
+	complete_all(&start);
+	/* Threads only stop once they are done, see test-slab.c */
+	wait_for_completion(&done);
+	ns = bench_now() - ns;
+
+	for (i = 0; i < nr_threads; i++) {
+		kthread_stop(w[i].task);
+		if (w[i].error)
+			err = w[i].error;
+	}
+	if (err)
+		return err;
+
+	pr_info("test_zram: write %2d threads: %llu pages/s\n", nr_threads,
+		div64_u64((u64)writes * nr_threads * NSEC_PER_SEC,
+			  ns ? ns : 1));
+	return 0;
+}
+
+static int __init bench_write(struct block_device *bdev)
+{
+	struct zram_bench_writer *w;
+	int i, nr_cpus, err = 0;
+
+	get_online_cpus();
+	nr_cpus = num_online_cpus();
+
+	if (((u64)writes * nr_cpus) << PAGE_SHIFT >
+	    i_size_read(bdev->bd_inode)) {
+		pr_err("test_zram: %s is smaller than %d times %u pages\n",
+		       path, nr_cpus, writes);
+		err = -ENOSPC;
+		goto out;
+	}
+
+	w = kcalloc(nr_cpus, sizeof(*w), GFP_KERNEL);
+	if (!w) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < nr_cpus; i++) {
+		w[i].bdev = bdev;
+		w[i].index = (pgoff_t)i * writes;
+		w[i].page = alloc_page(GFP_KERNEL);
+		if (!w[i].page) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+		bench_fill(w[i].page, w[i].index);
+	}
+
+	for (i = 1; i <= nr_cpus && !err; i++)
+		err = bench_write_run(w, i);
+
+out_free:
+	for (i = 0; i < nr_cpus; i++)
+		if (w[i].page)
+			__free_page(w[i].page);
+	kfree(w);
+out:
+	put_online_cpus();
+	return err;
+}
+
+static int __init bench_read(struct block_device *bdev, struct page **pages,
+			     unsigned int max)
+{
+	u64 start, ns, total_ns, max_ns;
+	unsigned int i, c, n;
+	pgoff_t index;
+	int err;
+
+	for (index = 0; index < (pgoff_t)count * max; index += max) {
+		for (i = 0; i < max; i++)
+			bench_fill(pages[i], index + i);
+		err = bench_rw(bdev, WRITE, pages, max, index);
+		if (err)
+			return err;
+	}
+
+	for (c = 0; c < nr_clusters; c++) {
+		n = clusters[c];
+		total_ns = max_ns = 0;
+		for (i = 0; i < count; i++) {
+			start = bench_now();
+			err = bench_rw(bdev, READ, pages, n, (pgoff_t)i * max);
+			if (err)
+				return err;
+			ns = bench_now() - start;
+			total_ns += ns;
+			max_ns = max(max_ns, ns);
+		}
+		pr_info("test_zram: read %2u pages: %llu us average, %llu us"
+			" max per cluster\n", n,
+			div_u64(total_ns, count * NSEC_PER_USEC),
+			div_u64(max_ns, NSEC_PER_USEC));
+	}
+
+	return 0;
+}
+
+static int __init test_zram_init(void)
+{
+	const fmode_t mode = FMODE_READ | FMODE_WRITE;
+	struct block_device *bdev;
+	struct page **pages;
+	unsigned int i, max = 0;
+	int err = 0;
+
+	if (!path || !count || !writes)
+		return -EINVAL;
+
+	for (i = 0; i < nr_clusters; i++) {
+		if (!clusters[i])
+			return -EINVAL;
+		max = max(max, clusters[i]);
+	}
+
+	bdev = open_bdev_exclusive(path, mode, &path);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	if (tests & 1) {
+		err = bench_write(bdev);
+		if (err)
+			goto out;
+	}
+	if (!(tests & 2))
+		goto out;
+
+	if (((u64)count * max) << PAGE_SHIFT > i_size_read(bdev->bd_inode)) {
+		pr_err("test_zram: %s is smaller than %u clusters of %u"
+		       " pages\n", path, count, max);
+		err = -ENOSPC;
+		goto out;
+	}
+
+	pages = kcalloc(max, sizeof(*pages), GFP_KERNEL);
+	if (!pages) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < max; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	err = bench_read(bdev, pages, max);
+
+out_free:
+	for (i = 0; i < max; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+	kfree(pages);
+out:
+	close_bdev_exclusive(bdev, mode);
+
+	/* Nothing to keep loaded */
+	return err ? err : -EAGAIN;
+}
+module_init(test_zram_init);
+MODULE_LICENSE("GPL");
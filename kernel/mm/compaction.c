@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 /*
@@ -604,3 +607,191 @@ void compaction_unregister_node(struct node *node)
 	return sysdev_remove_file(&node->sysdev, &attr_compact);
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
+
+/*
+ * Order kcompactd keeps available even when kswapd was woken for a smaller
+ * allocation. 0 means kcompactd only compacts for the orders kswapd was
+ * asked to reclaim for.
+ */
+int sysctl_compact_proactive_order;
+
+/*
+ * Returns true if compacting a zone for an allocation of the given order is
+ * worthwhile: a suitable page is not already free, migration has enough
+ * order-0 pages to work with and a failure would be due to fragmentation
+ * rather than a lack of memory.
+ */
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark = low_wmark_pages(zone) + (2UL << order);
+	int fragindex;
+
+	if (!populated_zone(zone))
+		return false;
+
+	if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+		return false;
+
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	fragindex = fragmentation_index(zone, order);
+	return fragindex > sysctl_extfrag_threshold;
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++)
+		if (kcompactd_zone_suitable(&pgdat->node_zones[zoneid], order))
+			return true;
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid;
+	int order = pgdat->kcompactd_max_order;
+	ktime_t start = ktime_get();
+
+	pgdat->kcompactd_max_order = 0;
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = allocflags_to_migratetype(GFP_KERNEL),
+			.zone = zone,
+		};
+
+		if (!kcompactd_zone_suitable(zone, order))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			defer_compaction(zone);
+			count_vm_event(KCOMPACTD_FAIL);
+		}
+
+		if (kthread_should_stop())
+			break;
+	}
+
+	count_vm_events(KCOMPACTD_TIME, ktime_us_delta(ktime_get(), start));
+}
+
+/*
+ * The background compaction daemon, one per node. It is woken by kswapd
+ * once reclaim is done and compacts the node so that high-order
+ * allocations do not have to stall in direct compaction.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order > 0 ||
+				kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - Ask the compaction daemon of a node for work
+ * @pgdat: The node kswapd has just balanced
+ * @order: The order kswapd was reclaiming for
+ *
+ * Called by kswapd when it is done. kcompactd is only woken if a page of
+ * @order, or of vm.compact_proactive_order if that is larger, is not
+ * available in some zone and compaction could provide one.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	order = max(order, sysctl_compact_proactive_order);
+	if (order <= 0)
+		return;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_INFO "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+
+module_init(kcompactd_init)
@@ -23,6 +23,8 @@
 #include <linux/uaccess.h>
 #include <linux/frontswap.h>
 #include <linux/swapfile.h>
+#include <linux/pagemap.h>
+#include <linux/writeback.h>
 
 /*
  * frontswap_ops is set by frontswap_register_ops to contain the pointers
@@ -43,6 +45,7 @@ static unsigned long frontswap_gets;
 static unsigned long frontswap_succ_puts;
 static unsigned long frontswap_failed_puts;
 static unsigned long frontswap_flushes;
+static unsigned long frontswap_writebacks;
 
 /*
  * register operations for frontswap, returning previous thus allowing
@@ -153,6 +156,62 @@ void __frontswap_flush_area(unsigned type)
 	memset(sis->frontswap_map, 0, sis->max / sizeof(long));
 }
 
+/*
+ * Move the page for swaptype and offset from frontswap to the swap device,
+ * so that the backend can free its copy: the page is read back through
+ * the swap cache, flushed from frontswap and written out, bypassing
+ * frontswap. Returns 0 if the page was written or no longer needs to be,
+ * an error if it could not be brought in or is busy. May sleep.
+ */
+int frontswap_writeback_page(unsigned type, pgoff_t offset)
+{
+	struct swap_info_struct *sis = swap_info[type];
+	swp_entry_t entry = swp_entry(type, offset);
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	struct page *page;
+	int ret = 0;
+
+	/* NULL if the swap entry was freed meanwhile, or out of memory */
+	page = read_swap_cache_async(entry, GFP_KERNEL, NULL, 0);
+	if (page == NULL)
+		return frontswap_test(sis, offset) ? -ENOMEM : 0;
+
+	lock_page(page);
+	if (!PageSwapCache(page) || page_private(page) != entry.val ||
+	    !frontswap_test(sis, offset))
+		goto out_unlock;
+	if (!PageUptodate(page)) {
+		ret = -EIO;
+		goto out_unlock;
+	}
+	if (PageWriteback(page)) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+	/* only the swap cache still refers to it: drop it instead */
+	if (try_to_free_swap(page))
+		goto out_unlock;
+
+	__frontswap_flush_page(type, offset);
+	frontswap_writebacks++;
+	/* a dirty page will be written out by reclaim in any case */
+	if (PageDirty(page))
+		goto out_unlock;
+	/* have end_page_writeback() rotate it for reclaim */
+	SetPageReclaim(page);
+	ret = __swap_writepage(page, &wbc);
+	page_cache_release(page);
+	return ret;
+
+out_unlock:
+	unlock_page(page);
+	page_cache_release(page);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(frontswap_writeback_page);
+
 /*
  * Frontswap, like a true swap device, may unnecessarily retain pages
  * under certain circumstances; "shrink" frontswap is essentially a
@@ -296,12 +355,20 @@ static ssize_t flushes_show(struct kobject *kobj,
 }
 FRONTSWAP_ATTR_RO(flushes);
 
+static ssize_t writebacks_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", frontswap_writebacks);
+}
+FRONTSWAP_ATTR_RO(writebacks);
+
 static struct attribute *frontswap_attrs[] = {
 	&curr_pages_attr.attr,
 	&succ_puts_attr.attr,
 	&failed_puts_attr.attr,
 	&gets_attr.attr,
 	&flushes_attr.attr,
+	&writebacks_attr.attr,
 	NULL,
 };
 
@@ -97,6 +97,11 @@ struct mm_slot {
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @vma_end: end of the vma being scanned, 0 when there is none
+ * @vma_scanned: pages scanned so far in the vma being scanned
+ * @vma_merged: of those, pages newly merged
+ * @pass_scanned: pages scanned so far in the current full scan
+ * @pass_merged: of those, pages newly merged
  *
  * There is only the one ksm_scan instance of this cursor structure.
  */
@@ -105,6 +110,11 @@ struct ksm_scan {
 	unsigned long address;
 	struct rmap_item **rmap_list;
 	unsigned long seqnr;
+	unsigned long vma_end;
+	unsigned long vma_scanned;
+	unsigned long vma_merged;
+	unsigned long pass_scanned;
+	unsigned long pass_merged;
 };
 
 /**
@@ -185,6 +195,30 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Adapt the number of pages scanned per batch to the merge yield */
+static unsigned int ksm_auto_scan;
+
+/* Pages ksmd scans per batch when ksm_auto_scan is set */
+static unsigned int ksm_scan_batch = 100;
+
+/* Merges per 1000 pages scanned below which the yield is low */
+static unsigned int ksm_cold_yield = 2;
+
+/* The number of pages ksmd has scanned */
+static unsigned long ksm_pages_scanned;
+
+/* The number of times ksmd has skipped a vma with low yield */
+static unsigned long ksm_vmas_skipped;
+
+/*
+ * A vma with low yield in two or more full scans in a row is skipped for
+ * 1, 3, 7, ... up to 2^KSM_COLD_MAX_SHIFT - 1 following full scans.
+ */
+#define KSM_COLD_MAX_SHIFT	4
+
+/* With ksm_auto_scan, scan at least pages_to_scan >> KSM_SCAN_BATCH_SHIFT */
+#define KSM_SCAN_BATCH_SHIFT	4
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -243,6 +277,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -470,6 +505,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -557,6 +593,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
@@ -1141,6 +1178,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1249,6 +1287,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1256,6 +1295,109 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * ksm_vma_scanned - ksmd has reached the end of a vma: if few enough of its
+ * pages were merged, and also in the previous full scan, skip it for a
+ * while. Any merge brings it back to being scanned every time. @vma may be
+ * NULL if it went away meanwhile, then only the counts are reset.
+ */
+static void ksm_vma_scanned(struct vm_area_struct *vma)
+{
+	unsigned long scanned = ksm_scan.vma_scanned;
+	unsigned long merged = ksm_scan.vma_merged;
+
+	ksm_scan.vma_end = 0;
+	ksm_scan.vma_scanned = 0;
+	ksm_scan.vma_merged = 0;
+	if (!vma || !scanned)
+		return;
+
+	if (merged * 1000 >= scanned * ksm_cold_yield) {
+		vma->ksm_cold = 0;
+		return;
+	}
+
+	if (vma->ksm_cold <= KSM_COLD_MAX_SHIFT)
+		vma->ksm_cold++;
+	if (vma->ksm_cold > 1)
+		vma->ksm_skip = (1 << (vma->ksm_cold - 1)) - 1;
+}
+
+/*
+ * ksm_skip_vma - move the scanning cursor past a vma without scanning it.
+ * Its rmap_items are kept, so that its merged pages stay accounted, but
+ * they are taken out of the unstable tree: it is rebuilt on every scan.
+ */
+static void ksm_skip_vma(struct vm_area_struct *vma)
+{
+	struct rmap_item *rmap_item;
+
+	while ((rmap_item = *ksm_scan.rmap_list)) {
+		unsigned long addr = rmap_item->address & PAGE_MASK;
+
+		if (addr >= vma->vm_end)
+			break;
+		if (addr < vma->vm_start) {
+			*ksm_scan.rmap_list = rmap_item->rmap_list;
+			remove_rmap_item_from_tree(rmap_item);
+			free_rmap_item(rmap_item);
+			continue;
+		}
+		if (rmap_item->address & UNSTABLE_FLAG)
+			remove_rmap_item_from_tree(rmap_item);
+		ksm_scan.rmap_list = &rmap_item->rmap_list;
+	}
+
+	vma->ksm_skip--;
+	ksm_vmas_skipped++;
+	ksm_scan.address = vma->vm_end;
+}
+
+/*
+ * ksm_adapt_scan_batch - at the end of a full scan, halve the auto_scan
+ * batch if its yield was low, double it if it was four times higher.
+ * It stays between pages_to_scan >> KSM_SCAN_BATCH_SHIFT and pages_to_scan.
+ */
+static void ksm_adapt_scan_batch(void)
+{
+	unsigned long scanned = ksm_scan.pass_scanned;
+	unsigned long merged = ksm_scan.pass_merged;
+	unsigned int max_batch = ksm_thread_pages_to_scan;
+	unsigned int min_batch = max(max_batch >> KSM_SCAN_BATCH_SHIFT, 1U);
+
+	ksm_scan.pass_scanned = 0;
+	ksm_scan.pass_merged = 0;
+	if (!scanned)
+		return;
+
+	if (merged * 1000 < scanned * ksm_cold_yield)
+		ksm_scan_batch >>= 1;
+	else if (merged * 1000 >= scanned * 4 * ksm_cold_yield)
+		ksm_scan_batch <<= 1;
+	ksm_scan_batch = clamp(ksm_scan_batch, min_batch, max_batch);
+}
+
+/*
+ * ksm_scan_soon - a new area of @mm was made mergeable: clear the low yield
+ * history of @vma, move @mm just after the scanning cursor, and let ksmd
+ * scan at full rate again, so that the new area is scanned promptly.
+ */
+static void ksm_scan_soon(struct mm_struct *mm, struct vm_area_struct *vma)
+{
+	struct mm_slot *mm_slot;
+
+	vma->ksm_cold = 0;
+	vma->ksm_skip = 0;
+
+	spin_lock(&ksm_mmlist_lock);
+	mm_slot = get_mm_slot(mm);
+	if (mm_slot && mm_slot != ksm_scan.mm_slot)
+		list_move(&mm_slot->mm_list, &ksm_scan.mm_slot->mm_list);
+	spin_unlock(&ksm_mmlist_lock);
+
+	ksm_scan_batch = ksm_thread_pages_to_scan;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1295,10 +1437,26 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		ksm_scan.vma_end = 0;
+		ksm_scan.vma_scanned = 0;
+		ksm_scan.vma_merged = 0;
 	}
 
 	mm = slot->mm;
 	down_read(&mm->mmap_sem);
+	/*
+	 * If the last call returned the last page of a vma, that vma is only
+	 * done now that the page has been counted.
+	 */
+	if (ksm_scan.vma_end && ksm_scan.address >= ksm_scan.vma_end) {
+		vma = NULL;
+		if (!ksm_test_exit(mm))
+			vma = find_vma(mm, ksm_scan.vma_end - 1);
+		if (vma && vma->vm_end != ksm_scan.vma_end)
+			vma = NULL;
+		ksm_vma_scanned(vma);
+	}
+
 	if (ksm_test_exit(mm))
 		vma = NULL;
 	else
@@ -1307,10 +1465,15 @@ next_mm:
 	for (; vma; vma = vma->vm_next) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
 			continue;
+		if (vma->ksm_skip && ksm_scan.address <= vma->vm_start) {
+			ksm_skip_vma(vma);
+			continue;
+		}
 		if (ksm_scan.address < vma->vm_start)
 			ksm_scan.address = vma->vm_start;
 		if (!vma->anon_vma)
 			ksm_scan.address = vma->vm_end;
+		ksm_scan.vma_end = vma->vm_end;
 
 		while (ksm_scan.address < vma->vm_end) {
 			if (ksm_test_exit(mm))
@@ -1335,6 +1498,8 @@ next_mm:
 			ksm_scan.address += PAGE_SIZE;
 			cond_resched();
 		}
+		if (ksm_scan.address >= vma->vm_end)
+			ksm_vma_scanned(vma);
 	}
 
 	if (ksm_test_exit(mm)) {
@@ -1379,6 +1544,7 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_adapt_scan_batch();
 	return NULL;
 }
 
@@ -1396,12 +1562,28 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
+		ksm_pages_scanned++;
+		rmap_item->mm->ksm_pages_scanned++;
+		ksm_scan.vma_scanned++;
+		ksm_scan.pass_scanned++;
+		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
 			cmp_and_merge_page(page, rmap_item);
+			if (in_stable_tree(rmap_item)) {
+				ksm_scan.vma_merged++;
+				ksm_scan.pass_merged++;
+			}
+		}
 		put_page(page);
 	}
 }
 
+static unsigned int ksmd_pages_to_scan(void)
+{
+	if (ksm_auto_scan)
+		return min(ksm_scan_batch, ksm_thread_pages_to_scan);
+	return ksm_thread_pages_to_scan;
+}
+
 static int ksmd_should_run(void)
 {
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
@@ -1414,7 +1596,7 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksmd_pages_to_scan());
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
@@ -1450,6 +1632,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 			if (err)
 				return err;
 		}
+		ksm_scan_soon(mm, vma);
 
 		*vm_flags |= VM_MERGEABLE;
 		break;
@@ -1849,6 +2032,62 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t auto_scan_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_scan);
+}
+
+static ssize_t auto_scan_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	int err;
+	unsigned long enable;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto_scan = enable;
+	ksm_scan_batch = ksm_thread_pages_to_scan;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_scan);
+
+static ssize_t cold_yield_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_cold_yield);
+}
+
+static ssize_t cold_yield_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	int err;
+	unsigned long yield;
+
+	err = strict_strtoul(buf, 10, &yield);
+	if (err || yield > 1000)
+		return -EINVAL;
+
+	ksm_cold_yield = yield;
+
+	return count;
+}
+KSM_ATTR(cold_yield);
+
+static ssize_t scan_batch_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksmd_pages_to_scan());
+}
+KSM_ATTR_RO(scan_batch);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1941,6 +2180,20 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+static ssize_t vmas_skipped_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_vmas_skipped);
+}
+KSM_ATTR_RO(vmas_skipped);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1950,6 +2203,11 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&auto_scan_attr.attr,
+	&cold_yield_attr.attr,
+	&scan_batch_attr.attr,
+	&pages_scanned_attr.attr,
+	&vmas_skipped_attr.attr,
 	NULL,
 };
 
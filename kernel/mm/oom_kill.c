@@ -504,6 +504,25 @@ int unregister_oom_notifier(struct notifier_block *nb)
 }
 EXPORT_SYMBOL_GPL(unregister_oom_notifier);
 
+static ATOMIC_NOTIFIER_HEAD(oom_adj_notify_list);
+
+int register_oom_adj_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&oom_adj_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(register_oom_adj_notifier);
+
+int unregister_oom_adj_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&oom_adj_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_oom_adj_notifier);
+
+void oom_adj_notify(unsigned long event, struct task_struct *p)
+{
+	atomic_notifier_call_chain(&oom_adj_notify_list, event, p);
+}
+
 /*
  * Try to acquire the OOM killer lock for the zones in zonelist.  Returns zero
  * if a parallel OOM killing is already taking place that includes a zone in
@@ -45,6 +45,8 @@
 #include <linux/backing-dev.h>
 #include <linux/fault-inject.h>
 #include <linux/page-isolation.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
@@ -626,6 +628,39 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * The per-cpu lists are refilled from and drained to the buddy allocator in
+ * batches of pcp->batch pages. A CPU that keeps allocating without freeing,
+ * or freeing without allocating, moves growing multiples of the batch
+ * instead so that it takes zone->lock less often. Every free halves the
+ * refill scale and every allocation halves the drain scale, so CPUs that
+ * both allocate and free stay close to the base batch.
+ */
+#define PCP_BATCH_SCALE_MAX	5
+
+static int pcp_alloc_batch(struct per_cpu_pages *pcp)
+{
+	int max_batch = max(pcp->high - pcp->count, pcp->batch);
+	int batch = min(pcp->batch << pcp->alloc_factor, max_batch);
+
+	if (batch < max_batch && pcp->alloc_factor < PCP_BATCH_SCALE_MAX)
+		pcp->alloc_factor++;
+
+	return batch;
+}
+
+static int pcp_free_batch(struct per_cpu_pages *pcp)
+{
+	/* Keep a batch on the lists for the next allocations */
+	int max_batch = max(pcp->count - pcp->batch, pcp->batch);
+	int batch = min(pcp->batch << pcp->free_factor, max_batch);
+
+	if (batch < max_batch && pcp->free_factor < PCP_BATCH_SCALE_MAX)
+		pcp->free_factor++;
+
+	return batch;
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -819,11 +854,16 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -919,12 +959,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -938,11 +978,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * agressive about taking ownership of free pages
+			 * agressive about taking ownership of free pages.
+			 * CMA pageblocks are never taken over.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -961,7 +1003,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1037,7 +1080,11 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/* Pages of a CMA pageblock must go back to its free lists */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+		else
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1193,9 +1240,12 @@ void free_hot_cold_page(struct page *page, int cold)
 	else
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
+	pcp->alloc_factor >>= 1;
 	if (pcp->count >= pcp->high) {
-		free_pcppages_bulk(zone, pcp->batch, pcp);
-		pcp->count -= pcp->batch;
+		int batch = pcp_free_batch(pcp);
+
+		free_pcppages_bulk(zone, batch, pcp);
+		pcp->count -= batch;
 	}
 
 out:
@@ -1297,9 +1347,10 @@ again:
 		local_irq_save(flags);
 		pcp = &this_cpu_ptr(zone->pageset)->pcp;
 		list = &pcp->lists[migratetype];
+		pcp->free_factor >>= 1;
 		if (list_empty(list)) {
 			pcp->count += rmqueue_bulk(zone, 0,
-					pcp->batch, list,
+					pcp_alloc_batch(pcp), list,
 					migratetype, cold);
 			if (unlikely(list_empty(list)))
 				goto failed;
@@ -2160,6 +2211,125 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/**
+ * alloc_pages_bulk - Allocate a number of order-0 pages to a list
+ * @gfp_mask: GFP flags for the allocation
+ * @nr_pages: The number of pages wanted
+ * @list: List to add the allocated pages to
+ *
+ * The pages are taken from the per-cpu list of the first zone that has
+ * enough free pages for all of them above its low watermark. When that list
+ * runs empty, it is refilled from the buddy allocator with all the pages
+ * still missing under a single acquisition of zone->lock. If no zone can
+ * take the whole request, one page is allocated through the normal path,
+ * which may reclaim memory.
+ *
+ * At most pcp->high pages are taken per call. Returns the number of pages
+ * added to @list, which may be less than @nr_pages. Callers that need all
+ * of them should call again for the rest.
+ */
+unsigned long alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+						struct list_head *list)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int cold = !!(gfp_mask & __GFP_COLD);
+	struct zonelist *zonelist = node_zonelist(numa_node_id(), gfp_mask);
+	struct zone *preferred_zone, *zone;
+	struct zoneref *z;
+	struct per_cpu_pages *pcp;
+	struct list_head *pcp_list;
+	struct page *page, *next;
+	unsigned long flags, nr = 0;
+	LIST_HEAD(taken);
+
+	gfp_mask &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(gfp_mask);
+
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	if (!nr_pages)
+		return 0;
+
+	if (nr_pages == 1 || should_fail_alloc_page(gfp_mask, 0))
+		goto single;
+
+	if (unlikely(!zonelist->_zonerefs->zone))
+		return 0;
+
+	get_mems_allowed();
+	first_zones_zonelist(zonelist, high_zoneidx, NULL, &preferred_zone);
+	if (!preferred_zone)
+		goto put_mems;
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
+		unsigned long mark = low_wmark_pages(zone) + nr_pages;
+
+		if (!cpuset_zone_allowed_softwall(zone, gfp_mask))
+			continue;
+		if (zone_watermark_ok(zone, 0, mark, zone_idx(preferred_zone),
+					ALLOC_WMARK_LOW | ALLOC_CPUSET))
+			break;
+	}
+	if (!zone)
+		goto put_mems;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	pcp_list = &pcp->lists[migratetype];
+	pcp->free_factor >>= 1;
+	/* Bound the time spent with interrupts disabled */
+	nr_pages = min_t(unsigned long, nr_pages, max(pcp->high, pcp->batch));
+	while (nr < nr_pages) {
+		if (list_empty(pcp_list)) {
+			pcp->count += rmqueue_bulk(zone, 0,
+					max_t(unsigned long, pcp->batch,
+						nr_pages - nr),
+					pcp_list, migratetype, cold);
+			if (unlikely(list_empty(pcp_list)))
+				break;
+		}
+
+		if (cold)
+			page = list_entry(pcp_list->prev, struct page, lru);
+		else
+			page = list_entry(pcp_list->next, struct page, lru);
+
+		list_move_tail(&page->lru, &taken);
+		pcp->count--;
+		zone_statistics(preferred_zone, zone);
+		nr++;
+	}
+	__count_zone_vm_events(PGALLOC, zone, nr);
+	local_irq_restore(flags);
+
+	list_for_each_entry_safe(page, next, &taken, lru) {
+		list_del(&page->lru);
+		if (prep_new_page(page, 0, gfp_mask)) {
+			nr--;
+			continue;
+		}
+		trace_mm_page_alloc(page, 0, gfp_mask, migratetype);
+		list_add_tail(&page->lru, list);
+	}
+
+put_mems:
+	put_mems_allowed();
+	if (nr)
+		return nr;
+
+single:
+	page = alloc_pages(gfp_mask, 0);
+	if (!page)
+		return 0;
+
+	list_add_tail(&page->lru, list);
+
+	return 1;
+}
+EXPORT_SYMBOL(alloc_pages_bulk);
+
 /*
  * Common helper functions.
  */
@@ -3401,6 +3571,33 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 		pcp->batch = PAGE_SHIFT * 8;
 }
 
+/*
+ * The fraction of the zone its per-cpu pagelists may hold: the zone's own
+ * percpu_pagelist_zone_fraction entry if set, else percpu_pagelist_fraction.
+ * 0 means the boot time defaults from zone_batchsize().
+ */
+static int zone_pagelist_fraction(struct zone *zone)
+{
+	int fraction = sysctl_percpu_pagelist_zone_fraction[zone_idx(zone)];
+
+	return fraction ? fraction : percpu_pagelist_fraction;
+}
+
+static void zone_pageset_set_high_and_batch(struct zone *zone,
+						struct per_cpu_pageset *p)
+{
+	int fraction = zone_pagelist_fraction(zone);
+
+	if (fraction) {
+		setup_pagelist_highmark(p, zone->present_pages / fraction);
+	} else {
+		unsigned long batch = zone_batchsize(zone);
+
+		p->pcp.high = 6 * batch;
+		p->pcp.batch = max(1UL, 1 * batch);
+	}
+}
+
 static __meminit void setup_zone_pageset(struct zone *zone)
 {
 	int cpu;
@@ -3412,10 +3609,8 @@ static __meminit void setup_zone_pageset(struct zone *zone)
 
 		setup_pageset(pcp, zone_batchsize(zone));
 
-		if (percpu_pagelist_fraction)
-			setup_pagelist_highmark(pcp,
-				(zone->present_pages /
-					percpu_pagelist_fraction));
+		if (zone_pagelist_fraction(zone))
+			zone_pageset_set_high_and_batch(zone, pcp);
 	}
 }
 
@@ -4075,6 +4270,10 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->kcompactd_max_order = 0;
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -5098,13 +5297,48 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	if (!write || (ret == -EINVAL))
 		return ret;
 	for_each_populated_zone(zone) {
-		for_each_possible_cpu(cpu) {
-			unsigned long  high;
-			high = zone->present_pages / percpu_pagelist_fraction;
-			setup_pagelist_highmark(
-				per_cpu_ptr(zone->pageset, cpu), high);
+		for_each_possible_cpu(cpu)
+			zone_pageset_set_high_and_batch(zone,
+					per_cpu_ptr(zone->pageset, cpu));
+	}
+	return 0;
+}
+
+/*
+ * percpu_pagelist_zone_fraction - overrides percpu_pagelist_fraction for
+ * each zone type. 0 entries use percpu_pagelist_fraction.
+ */
+int sysctl_percpu_pagelist_zone_fraction[MAX_NR_ZONES];
+
+int percpu_pagelist_zone_fraction_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int old[MAX_NR_ZONES];
+	struct zone *zone;
+	unsigned int cpu;
+	int i, ret;
+
+	memcpy(old, sysctl_percpu_pagelist_zone_fraction, sizeof(old));
+	ret = proc_dointvec(table, write, buffer, length, ppos);
+	if (!write || ret)
+		return ret;
+
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		int fraction = sysctl_percpu_pagelist_zone_fraction[i];
+
+		/* Same minimum as percpu_pagelist_fraction */
+		if (fraction != 0 && fraction < 8) {
+			memcpy(sysctl_percpu_pagelist_zone_fraction, old,
+								sizeof(old));
+			return -EINVAL;
 		}
 	}
+
+	for_each_populated_zone(zone) {
+		for_each_possible_cpu(cpu)
+			zone_pageset_set_high_and_batch(zone,
+					per_cpu_ptr(zone->pageset, cpu));
+	}
 	return 0;
 }
 
@@ -5315,6 +5549,7 @@ int set_migratetype_isolate(struct page *page)
 
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)) ||
 	    zone_idx == ZONE_MOVABLE) {
 		ret = 0;
 		goto out;
@@ -5367,7 +5602,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5375,8 +5610,8 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
@@ -5428,6 +5663,205 @@ __offline_isolated_pages(unsigned long start_pfn, unsigned long end_pfn)
 }
 #endif
 
+#ifdef CONFIG_CMA
+/**
+ * init_cma_range() - Give a range of memory to the page allocator as CMA
+ * @start_pfn: The first PFN of the range, aligned to pageblock_nr_pages
+ * @end_pfn: The PFN after the range, aligned to pageblock_nr_pages
+ *
+ * Frees the range into MIGRATE_CMA pageblocks. Only movable allocations
+ * fall back to them, so alloc_contig_range() can empty any part of the
+ * range again later on. The range must be RAM of a single zone that was
+ * reserved at boot, so that nothing else allocated from it before.
+ */
+int init_cma_range(unsigned long start_pfn, unsigned long end_pfn)
+{
+	struct zone *zone;
+	unsigned long pfn, i;
+
+	if (start_pfn >= end_pfn ||
+	    ((start_pfn | end_pfn) & (pageblock_nr_pages - 1)))
+		return -EINVAL;
+
+	for (pfn = start_pfn; pfn < end_pfn; pfn++)
+		if (!pfn_valid(pfn) || !PageReserved(pfn_to_page(pfn)))
+			return -EINVAL;
+
+	zone = page_zone(pfn_to_page(start_pfn));
+	if (page_zone(pfn_to_page(end_pfn - 1)) != zone)
+		return -EINVAL;
+
+	for (pfn = start_pfn; pfn < end_pfn; pfn += pageblock_nr_pages) {
+		struct page *page = pfn_to_page(pfn);
+
+		for (i = 0; i < pageblock_nr_pages; i++) {
+			__ClearPageReserved(page + i);
+			set_page_count(page + i, 0);
+		}
+		set_pageblock_migratetype(page, MIGRATE_CMA);
+		set_page_refcounted(page);
+		__free_pages(page, pageblock_order);
+	}
+
+	totalram_pages += end_pfn - start_pfn;
+#ifdef CONFIG_HIGHMEM
+	if (is_highmem(zone))
+		totalhigh_pages += end_pfn - start_pfn;
+#endif
+
+	return 0;
+}
+
+static struct page *
+alloc_contig_migrate_target(struct page *page, unsigned long private,
+							int **resultp)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/*
+ * Migrate the LRU pages in [start, end) out of the range, which must be
+ * isolated. Pages that are pinned stay where they are.
+ */
+static void __alloc_contig_migrate_range(unsigned long start,
+							unsigned long end)
+{
+	int tries;
+
+	migrate_prep();
+
+	for (tries = 0; tries < 5; tries++) {
+		LIST_HEAD(pages);
+		unsigned long pfn;
+		int nr_isolated = 0;
+
+		for (pfn = start; pfn < end; pfn++) {
+			struct page *page = pfn_to_page(pfn);
+
+			if (!PageLRU(page) || !get_page_unless_zero(page))
+				continue;
+
+			if (!isolate_lru_page(page)) {
+				list_add_tail(&page->lru, &pages);
+				inc_zone_page_state(page, NR_ISOLATED_ANON +
+						page_is_file_cache(page));
+				nr_isolated++;
+			}
+			put_page(page);
+		}
+
+		if (!nr_isolated)
+			break;
+
+		if (migrate_pages(&pages, alloc_contig_migrate_target, 0, 0))
+			putback_lru_pages(&pages);
+	}
+}
+
+/* Returns the free buddy page containing pfn. Call with zone->lock held. */
+static struct page *__free_page_containing(unsigned long pfn)
+{
+	int order;
+
+	for (order = 0; order < MAX_ORDER; order++) {
+		struct page *page = pfn_to_page(pfn & ~((1UL << order) - 1));
+
+		if (PageBuddy(page) && page_order(page) >= order)
+			return page;
+	}
+
+	return NULL;
+}
+
+/**
+ * alloc_contig_range() - Allocate a range of pages of a CMA region
+ * @start: The first PFN to allocate
+ * @end: The PFN after the last one to allocate
+ *
+ * The pageblocks around [start, end) are isolated and the pages in use in
+ * the range are migrated elsewhere. Once the whole range is free, it is
+ * taken from the buddy allocator and every page of it is returned with a
+ * reference count of one, to be given back with free_contig_range().
+ *
+ * The range must lie within a region set up with init_cma_range(), and
+ * calls for pageblocks that may overlap must be serialized by the caller.
+ * Returns 0 on success or -EBUSY if some page in the range could not be
+ * freed.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	unsigned long outer_start = start & ~(pageblock_nr_pages - 1);
+	unsigned long outer_end = ALIGN(end, pageblock_nr_pages);
+	unsigned long taken_start = 0, taken_end = 0;
+	unsigned long flags, pfn;
+	struct zone *zone = page_zone(pfn_to_page(start));
+	struct page *page;
+	int ret;
+
+	ret = start_isolate_page_range(outer_start, outer_end, MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	__alloc_contig_migrate_range(start, end);
+
+	/* Freed pages may still be on the per-cpu lists */
+	lru_add_drain_all();
+	drain_all_pages();
+
+	spin_lock_irqsave(&zone->lock, flags);
+
+	for (pfn = start; pfn < end; pfn += 1UL << page_order(page)) {
+		page = __free_page_containing(pfn);
+		if (!page) {
+			ret = -EBUSY;
+			goto out;
+		}
+		pfn = page_to_pfn(page);
+	}
+
+	taken_start = page_to_pfn(__free_page_containing(start));
+	for (pfn = taken_start; pfn < end; pfn = taken_end) {
+		unsigned int order;
+
+		page = pfn_to_page(pfn);
+		order = page_order(page);
+
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+		set_page_refcounted(page);
+		split_page(page, order);
+
+		taken_end = pfn + (1UL << order);
+	}
+
+out:
+	spin_unlock_irqrestore(&zone->lock, flags);
+
+	if (!ret) {
+		kernel_map_pages(pfn_to_page(taken_start),
+						taken_end - taken_start, 1);
+
+		/* Give back the pages of the buddies outside the range */
+		for (pfn = taken_start; pfn < start; pfn++)
+			__free_page(pfn_to_page(pfn));
+		for (pfn = end; pfn < taken_end; pfn++)
+			__free_page(pfn_to_page(pfn));
+	}
+
+	undo_isolate_page_range(outer_start, outer_end, MIGRATE_CMA);
+
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif /* CONFIG_CMA */
+
 #ifdef CONFIG_MEMORY_FAILURE
 bool is_free_buddy_page(struct page *page)
 {
@@ -247,6 +247,9 @@ struct array_cache {
 	unsigned int batchcount;
 	unsigned int touched;
 	spinlock_t lock;
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	unsigned long hotpath[NR_SLAB_HOTPATH_ITEMS];
+#endif
 	void *entry[];	/*
 			 * Must have this definition in here for the proper
 			 * alignment of array_cache. Also simplifies accessing
@@ -408,6 +411,14 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 #define STATS_INC_FREEMISS(x)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+#define HOTPATH_INC(ac, item)	((ac)->hotpath[SLAB_HOTPATH_##item]++)
+#define HOTPATH_RESET(ac)	memset((ac)->hotpath, 0, sizeof((ac)->hotpath))
+#else
+#define HOTPATH_INC(ac, item)	do { } while (0)
+#define HOTPATH_RESET(ac)	do { } while (0)
+#endif
+
 #if DEBUG
 
 /*
@@ -888,6 +899,7 @@ static struct array_cache *alloc_arraycache(int node, int entries,
 		nc->batchcount = batchcount;
 		nc->touched = 0;
 		spin_lock_init(&nc->lock);
+		HOTPATH_RESET(nc);
 	}
 	return nc;
 }
@@ -2129,6 +2141,7 @@ static int __init_refok setup_cpu_cache(struct kmem_cache *cachep, gfp_t gfp)
 	cpu_cache_get(cachep)->limit = BOOT_CPUCACHE_ENTRIES;
 	cpu_cache_get(cachep)->batchcount = 1;
 	cpu_cache_get(cachep)->touched = 0;
+	HOTPATH_RESET(cpu_cache_get(cachep));
 	cachep->batchcount = 1;
 	cachep->limit = BOOT_CPUCACHE_ENTRIES;
 	return 0;
@@ -3182,10 +3195,12 @@ static inline void *____cache_alloc(struct kmem_cache *cachep, gfp_t flags)
 	ac = cpu_cache_get(cachep);
 	if (likely(ac->avail)) {
 		STATS_INC_ALLOCHIT(cachep);
+		HOTPATH_INC(ac, ALLOC_FAST);
 		ac->touched = 1;
 		objp = ac->entry[--ac->avail];
 	} else {
 		STATS_INC_ALLOCMISS(cachep);
+		HOTPATH_INC(ac, ALLOC_SLOW);
 		objp = cache_alloc_refill(cachep, flags);
 		/*
 		 * the 'ac' may be updated by cache_alloc_refill(),
@@ -3620,15 +3635,19 @@ static inline void __cache_free(struct kmem_cache *cachep, void *objp)
 	 * variable to skip the call, which is mostly likely to be present in
 	 * the cache.
 	 */
-	if (nr_online_nodes > 1 && cache_free_alien(cachep, objp))
+	if (nr_online_nodes > 1 && cache_free_alien(cachep, objp)) {
+		HOTPATH_INC(ac, FREE_REMOTE);
 		return;
+	}
 
 	if (likely(ac->avail < ac->limit)) {
 		STATS_INC_FREEHIT(cachep);
+		HOTPATH_INC(ac, FREE_FAST);
 		ac->entry[ac->avail++] = objp;
 		return;
 	} else {
 		STATS_INC_FREEMISS(cachep);
+		HOTPATH_INC(ac, FREE_SLOW);
 		cache_flusharray(cachep, ac);
 		ac->entry[ac->avail++] = objp;
 	}
@@ -3970,6 +3989,12 @@ static void do_ccupdate_local(void *info)
 	check_irq_off();
 	old = cpu_cache_get(new->cachep);
 
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	/* Caches being created have no array yet */
+	if (old)
+		memcpy(new->new[smp_processor_id()]->hotpath, old->hotpath,
+		       sizeof(old->hotpath));
+#endif
 	new->cachep->array[smp_processor_id()] = new->new[smp_processor_id()];
 	new->new[smp_processor_id()] = old;
 }
@@ -4170,6 +4195,38 @@ out:
 
 #ifdef CONFIG_SLABINFO
 
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+static void __kmem_cache_hotpath_stats(struct kmem_cache *cachep,
+				       unsigned long *hotpath)
+{
+	struct array_cache *ac;
+	int cpu, i;
+
+	memset(hotpath, 0, NR_SLAB_HOTPATH_ITEMS * sizeof(*hotpath));
+	for_each_online_cpu(cpu) {
+		ac = cachep->array[cpu];
+		if (!ac)
+			continue;
+		for (i = 0; i < NR_SLAB_HOTPATH_ITEMS; i++)
+			hotpath[i] += ac->hotpath[i];
+	}
+}
+
+/**
+ * kmem_cache_hotpath_stats - Sum the fast and slow path counts of a cache
+ * @cachep: The cache to sum the counts of.
+ * @hotpath: NR_SLAB_HOTPATH_ITEMS counts, indexed by enum slab_hotpath_item.
+ */
+void kmem_cache_hotpath_stats(struct kmem_cache *cachep,
+			      unsigned long *hotpath)
+{
+	mutex_lock(&cache_chain_mutex);
+	__kmem_cache_hotpath_stats(cachep, hotpath);
+	mutex_unlock(&cache_chain_mutex);
+}
+EXPORT_SYMBOL(kmem_cache_hotpath_stats);
+#endif
+
 static void print_slabinfo_header(struct seq_file *m)
 {
 	/*
@@ -4190,6 +4247,7 @@ static void print_slabinfo_header(struct seq_file *m)
 		 "<error> <maxfreeable> <nodeallocs> <remotefrees> <alienoverflow>");
 	seq_puts(m, " : cpustat <allochit> <allocmiss> <freehit> <freemiss>");
 #endif
+	slabinfo_hotpath_header(m);
 	seq_putc(m, '\n');
 }
 
@@ -4306,6 +4364,14 @@ static int s_show(struct seq_file *m, void *p)
 		seq_printf(m, " : cpustat %6lu %6lu %6lu %6lu",
 			   allochit, allocmiss, freehit, freemiss);
 	}
+#endif
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	{
+		unsigned long hotpath[NR_SLAB_HOTPATH_ITEMS];
+
+		__kmem_cache_hotpath_stats(cachep, hotpath);
+		slabinfo_hotpath_show(m, hotpath);
+	}
 #endif
 	seq_putc(m, '\n');
 	return 0;
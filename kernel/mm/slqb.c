@@ -152,6 +152,14 @@ static inline void slqb_stat_add(struct kmem_cache_list *list,
 #endif
 }
 
+static inline void slqb_hotpath_inc(struct kmem_cache_cpu *c,
+				enum slab_hotpath_item item)
+{
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	c->hotpath[item]++;
+#endif
+}
+
 static inline int slqb_page_to_nid(struct slqb_page *page)
 {
 	return page_to_nid(&page->page);
@@ -1506,6 +1514,8 @@ static __always_inline void *__slab_alloc(struct kmem_cache *s,
 
 #ifdef CONFIG_NUMA
 	if (unlikely(node != -1) && unlikely(node != numa_node_id())) {
+		slqb_hotpath_inc(get_cpu_slab(s, smp_processor_id()),
+				SLAB_HOTPATH_ALLOC_SLOW);
 try_remote:
 		return __remote_slab_alloc(s, gfpflags, node);
 	}
@@ -1530,6 +1540,7 @@ try_remote:
 			object = __remote_slab_alloc(s, gfpflags, thisnode);
 #endif
 
+		slqb_hotpath_inc(c, SLAB_HOTPATH_ALLOC_SLOW);
 		if (!object) {
 			object = cache_list_get_page(s, l);
 			if (unlikely(!object)) {
@@ -1543,7 +1554,8 @@ try_remote:
 				return object;
 			}
 		}
-	}
+	} else
+		slqb_hotpath_inc(c, SLAB_HOTPATH_ALLOC_FAST);
 	if (likely(object))
 		slqb_stat_inc(l, ALLOC);
 	return object;
@@ -1765,8 +1777,11 @@ static __always_inline void __slab_free(struct kmem_cache *s,
 			l->freelist.tail = object;
 		l->freelist.nr++;
 
-		if (unlikely(l->freelist.nr > slab_hiwater(s)))
+		if (unlikely(l->freelist.nr > slab_hiwater(s))) {
+			slqb_hotpath_inc(c, SLAB_HOTPATH_FREE_SLOW);
 			flush_free_list(s, l);
+		} else
+			slqb_hotpath_inc(c, SLAB_HOTPATH_FREE_FAST);
 
 	} else {
 #ifdef CONFIG_SMP
@@ -1775,6 +1790,7 @@ static __always_inline void __slab_free(struct kmem_cache *s,
 		 */
 		slab_free_to_remote(s, page, object, c);
 		slqb_stat_inc(l, FREE_REMOTE);
+		slqb_hotpath_inc(c, SLAB_HOTPATH_FREE_REMOTE);
 #endif
 	}
 }
@@ -3311,6 +3327,35 @@ ssize_t slabinfo_write(struct file *file, const char __user * buffer,
 	return -EINVAL;
 }
 
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+static void __kmem_cache_hotpath_stats(struct kmem_cache *s,
+				unsigned long *hotpath)
+{
+	int cpu, i;
+
+	memset(hotpath, 0, NR_SLAB_HOTPATH_ITEMS * sizeof(*hotpath));
+	for_each_online_cpu(cpu) {
+		struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
+
+		for (i = 0; i < NR_SLAB_HOTPATH_ITEMS; i++)
+			hotpath[i] += c->hotpath[i];
+	}
+}
+
+/**
+ * kmem_cache_hotpath_stats - Sum the fast and slow path counts of a cache
+ * @s: The cache to sum the counts of.
+ * @hotpath: NR_SLAB_HOTPATH_ITEMS counts, indexed by enum slab_hotpath_item.
+ */
+void kmem_cache_hotpath_stats(struct kmem_cache *s, unsigned long *hotpath)
+{
+	down_read(&slqb_lock); /* hold off hotplug */
+	__kmem_cache_hotpath_stats(s, hotpath);
+	up_read(&slqb_lock);
+}
+EXPORT_SYMBOL(kmem_cache_hotpath_stats);
+#endif
+
 static void print_slabinfo_header(struct seq_file *m)
 {
 	seq_puts(m, "slabinfo - version: 2.1\n");
@@ -3318,6 +3363,7 @@ static void print_slabinfo_header(struct seq_file *m)
 		 "<objperslab> <pagesperslab>");
 	seq_puts(m, " : tunables <limit> <batchcount> <sharedfactor>");
 	seq_puts(m, " : slabdata <active_slabs> <num_slabs> <sharedavail>");
+	slabinfo_hotpath_header(m);
 	seq_putc(m, '\n');
 }
 
@@ -3357,6 +3403,14 @@ static int s_show(struct seq_file *m, void *p)
 			slab_freebatch(s), 0);
 	seq_printf(m, " : slabdata %6lu %6lu %6lu", stats.nr_slabs,
 			stats.nr_slabs, 0UL);
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	{
+		unsigned long hotpath[NR_SLAB_HOTPATH_ITEMS];
+
+		__kmem_cache_hotpath_stats(s, hotpath);
+		slabinfo_hotpath_show(m, hotpath);
+	}
+#endif
 	seq_putc(m, '\n');
 	return 0;
 }
@@ -217,6 +217,14 @@ static inline void stat(struct kmem_cache *s, enum stat_item si)
 #endif
 }
 
+static inline void hotpath_inc(struct kmem_cache *s,
+			       enum slab_hotpath_item item)
+{
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	__this_cpu_inc(s->cpu_slab->hotpath[item]);
+#endif
+}
+
 /********************************************************************
  * 			Core slab cache functions
  *******************************************************************/
@@ -1706,13 +1714,13 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	local_irq_save(flags);
 	c = __this_cpu_ptr(s->cpu_slab);
 	object = c->freelist;
-	if (unlikely(!object || !node_match(c, node)))
-
+	if (unlikely(!object || !node_match(c, node))) {
+		hotpath_inc(s, SLAB_HOTPATH_ALLOC_SLOW);
 		object = __slab_alloc(s, gfpflags, node, addr, c);
-
-	else {
+	} else {
 		c->freelist = get_freepointer(s, object);
 		stat(s, ALLOC_FASTPATH);
+		hotpath_inc(s, SLAB_HOTPATH_ALLOC_FAST);
 	}
 	local_irq_restore(flags);
 
@@ -1781,6 +1789,9 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 	void **object = (void *)x;
 
 	stat(s, FREE_SLOWPATH);
+	hotpath_inc(s, SLAB_HOTPATH_FREE_SLOW);
+	if (NUMA_BUILD && page_to_nid(page) != numa_node_id())
+		hotpath_inc(s, SLAB_HOTPATH_FREE_REMOTE);
 	slab_lock(page);
 
 	if (unlikely(SLABDEBUG && PageSlubDebug(page)))
@@ -1861,6 +1872,7 @@ static __always_inline void slab_free(struct kmem_cache *s,
 		set_freepointer(s, object, c->freelist);
 		c->freelist = object;
 		stat(s, FREE_FASTPATH);
+		hotpath_inc(s, SLAB_HOTPATH_FREE_FAST);
 	} else
 		__slab_free(s, page, x, addr);
 
@@ -4586,6 +4598,27 @@ __initcall(slab_sysfs_init);
  * The /proc/slabinfo ABI
  */
 #ifdef CONFIG_SLABINFO
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+/**
+ * kmem_cache_hotpath_stats - Sum the fast and slow path counts of a cache
+ * @s: The cache to sum the counts of.
+ * @hotpath: NR_SLAB_HOTPATH_ITEMS counts, indexed by enum slab_hotpath_item.
+ */
+void kmem_cache_hotpath_stats(struct kmem_cache *s, unsigned long *hotpath)
+{
+	int cpu, i;
+
+	memset(hotpath, 0, NR_SLAB_HOTPATH_ITEMS * sizeof(*hotpath));
+	for_each_possible_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+		for (i = 0; i < NR_SLAB_HOTPATH_ITEMS; i++)
+			hotpath[i] += c->hotpath[i];
+	}
+}
+EXPORT_SYMBOL(kmem_cache_hotpath_stats);
+#endif
+
 static void print_slabinfo_header(struct seq_file *m)
 {
 	seq_puts(m, "slabinfo - version: 2.1\n");
@@ -4593,6 +4626,7 @@ static void print_slabinfo_header(struct seq_file *m)
 		 "<objperslab> <pagesperslab>");
 	seq_puts(m, " : tunables <limit> <batchcount> <sharedfactor>");
 	seq_puts(m, " : slabdata <active_slabs> <num_slabs> <sharedavail>");
+	slabinfo_hotpath_header(m);
 	seq_putc(m, '\n');
 }
 
@@ -4649,6 +4683,14 @@ static int s_show(struct seq_file *m, void *p)
 	seq_printf(m, " : tunables %4u %4u %4u", 0, 0, 0);
 	seq_printf(m, " : slabdata %6lu %6lu %6lu", nr_slabs, nr_slabs,
 		   0UL);
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+	{
+		unsigned long hotpath[NR_SLAB_HOTPATH_ITEMS];
+
+		kmem_cache_hotpath_stats(s, hotpath);
+		slabinfo_hotpath_show(m, hotpath);
+	}
+#endif
 	seq_putc(m, '\n');
 	return 0;
 }
@@ -4,6 +4,7 @@
 #include <linux/module.h>
 #include <linux/err.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <asm/uaccess.h>
 
 #define CREATE_TRACE_POINTS
@@ -186,6 +187,28 @@ void kzfree(const void *p)
 }
 EXPORT_SYMBOL(kzfree);
 
+#ifdef CONFIG_SLAB_HOTPATH_STATS
+/*
+ * The /proc/slabinfo columns shared by the slab allocators for the counts
+ * they return from kmem_cache_hotpath_stats()
+ */
+void slabinfo_hotpath_header(struct seq_file *m)
+{
+	seq_puts(m, " : hotpath <allocfast> <allocslow> <freefast> <freeslow>"
+		 " <freeremote>");
+}
+
+void slabinfo_hotpath_show(struct seq_file *m, const unsigned long *hotpath)
+{
+	seq_printf(m, " : hotpath %8lu %8lu %8lu %8lu %8lu",
+		   hotpath[SLAB_HOTPATH_ALLOC_FAST],
+		   hotpath[SLAB_HOTPATH_ALLOC_SLOW],
+		   hotpath[SLAB_HOTPATH_FREE_FAST],
+		   hotpath[SLAB_HOTPATH_FREE_SLOW],
+		   hotpath[SLAB_HOTPATH_FREE_REMOTE]);
+}
+#endif
+
 int kern_ptr_validate(const void *ptr, unsigned long size)
 {
 	unsigned long addr = (unsigned long)ptr;
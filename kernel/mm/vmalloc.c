@@ -1543,13 +1543,30 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 		return NULL;
 	}
 
-	for (i = 0; i < area->nr_pages; i++) {
+	i = 0;
+	if (node < 0) {
+		struct page *page, *next;
+		LIST_HEAD(list);
+
+		/* Take the pages in batches rather than one by one */
+		while (i < area->nr_pages) {
+			if (!alloc_pages_bulk(gfp_mask, area->nr_pages - i,
+								&list)) {
+				/* Free the i pages we have in __vunmap() */
+				area->nr_pages = i;
+				goto fail;
+			}
+			list_for_each_entry_safe(page, next, &list, lru) {
+				list_del(&page->lru);
+				area->pages[i++] = page;
+			}
+		}
+	}
+
+	for (; i < area->nr_pages; i++) {
 		struct page *page;
 
-		if (node < 0)
-			page = alloc_page(gfp_mask);
-		else
-			page = alloc_pages_node(node, gfp_mask, 0);
+		page = alloc_pages_node(node, gfp_mask, 0);
 
 		if (unlikely(!page)) {
 			/* Successfully allocated i pages, free them in __vunmap() */
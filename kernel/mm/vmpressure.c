@@ -0,0 +1,83 @@
+/*
+ *  linux/mm/vmpressure.c
+ *
+ *  Reclaim efficiency as a measure of memory pressure.
+ *
+ *  Page reclaim reports the pages it scanned and reclaimed; once a
+ *  window of scanned pages is complete, the share that could not be
+ *  reclaimed is passed to the listeners. A low value means reclaim
+ *  finds easy pages, while a value close to 100 means that it mostly
+ *  scans pages it cannot free and that the system is about to thrash
+ *  or go out of memory.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/vmpressure.h>
+
+/*
+ * 16 reclaim batches, large enough not to react to a single unlucky
+ * scan, small enough to follow changes within a few kswapd passes.
+ */
+#define VMPRESSURE_WIN		(SWAP_CLUSTER_MAX * 16)
+
+static DEFINE_SPINLOCK(vmpressure_lock);
+static unsigned long vmpressure_scanned;
+static unsigned long vmpressure_reclaimed;
+
+static ATOMIC_NOTIFIER_HEAD(vmpressure_notify_list);
+
+int register_vmpressure_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&vmpressure_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(register_vmpressure_notifier);
+
+int unregister_vmpressure_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&vmpressure_notify_list, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_vmpressure_notifier);
+
+/**
+ * vmpressure() - account the result of a reclaim pass
+ * @gfp_mask:	allocation flags the reclaim was done for
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ */
+void vmpressure(gfp_t gfp_mask, unsigned long scanned,
+		unsigned long reclaimed)
+{
+	unsigned long pressure = 0;
+
+	/*
+	 * Reclaim on behalf of allocations that can neither do I/O nor be
+	 * placed in highmem or movable zones says little about the memory
+	 * available to user space.
+	 */
+	if (!(gfp_mask & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+	if (!scanned)
+		return;
+
+	spin_lock(&vmpressure_lock);
+	vmpressure_scanned += scanned;
+	vmpressure_reclaimed += reclaimed;
+	scanned = vmpressure_scanned;
+	reclaimed = vmpressure_reclaimed;
+	if (scanned < VMPRESSURE_WIN) {
+		spin_unlock(&vmpressure_lock);
+		return;
+	}
+	vmpressure_scanned = 0;
+	vmpressure_reclaimed = 0;
+	spin_unlock(&vmpressure_lock);
+
+	if (reclaimed < scanned)
+		pressure = 100 - reclaimed * 100 / scanned;
+
+	atomic_notifier_call_chain(&vmpressure_notify_list, pressure, NULL);
+}
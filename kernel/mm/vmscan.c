@@ -40,6 +40,8 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/vmpressure.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -1693,6 +1695,8 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long nr_scanned = sc->nr_scanned;
+	unsigned long nr_reclaimed_start = nr_reclaimed;
 
 	get_scan_count(zone, sc, nr, priority);
 
@@ -1724,6 +1728,10 @@ static void shrink_zone(int priority, struct zone *zone,
 
 	sc->nr_reclaimed = nr_reclaimed;
 
+	if (scanning_global_lru(sc))
+		vmpressure(sc->gfp_mask, sc->nr_scanned - nr_scanned,
+			   nr_reclaimed - nr_reclaimed_start);
+
 	/*
 	 * Even if we did not try to evict anon pages at all, we want to
 	 * rebalance the anon lru active/inactive ratio.
@@ -2372,8 +2380,10 @@ static int kswapd(void *p)
 		 * We can speed up thawing tasks if we don't call balance_pgdat
 		 * after returning from the refrigerator
 		 */
-		if (!ret)
+		if (!ret) {
 			balance_pgdat(pgdat, order);
+			wakeup_kcompactd(pgdat, order);
+		}
 	}
 	return 0;
 }
@@ -481,6 +481,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -796,6 +799,10 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_success",
+	"compact_daemon_fail",
+	"compact_daemon_time_us",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE